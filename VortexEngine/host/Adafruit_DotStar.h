@@ -0,0 +1,18 @@
+#ifndef HOST_ADAFRUIT_DOTSTAR_H
+#define HOST_ADAFRUIT_DOTSTAR_H
+
+// Minimal stand-in for the onboard dotstar, it does nothing
+
+#include <inttypes.h>
+
+#define DOTSTAR_BGR (2 | (1 << 2) | (0 << 4))
+
+class Adafruit_DotStar
+{
+public:
+  Adafruit_DotStar(uint16_t, uint8_t, uint8_t, uint8_t = DOTSTAR_BGR) {}
+  void begin() {}
+  void show() {}
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+// Minimal stand-in for the arduino core so the engine can be compiled
+// and driven on a regular linux machine, see the Makefile
+
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT         0x0
+#define OUTPUT        0x1
+#define INPUT_PULLUP  0x2
+
+#define CHANGE  2
+#define FALLING 3
+#define RISING  4
+
+// time is driven by the host framework (see TestFrameworkLinux.h)
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// deterministic random number generator
+void randomSeed(unsigned long seed);
+long random(long howbig);
+long random(long howsmall, long howbig);
+
+// pins
+void pinMode(uint32_t pin, uint32_t mode);
+void digitalWrite(uint32_t pin, uint32_t val);
+int digitalRead(uint32_t pin);
+int analogRead(uint32_t pin);
+
+// interrupts
+typedef void (*voidFuncPtr)(void);
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint32_t pin, voidFuncPtr callback, uint32_t mode);
+void detachInterrupt(uint32_t pin);
+
+// the test framework feeds IR timings straight to the receiver
+// and the sender writes marks/spaces straight to the framework
+void installIRCallback(void (*callback)(uint32_t));
+void test_ir_mark(uint32_t duration);
+void test_ir_space(uint32_t duration);
+
+// the serial port never connects on the host, logging goes
+// through TestFramework::printlog instead
+class HostSerial
+{
+public:
+  void begin(unsigned long) {}
+  void println(const char *) {}
+  operator bool() const { return false; }
+};
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef HOST_FASTLED_H
+#define HOST_FASTLED_H
+
+// Minimal stand-in for FastLED, the 'strip' is just the pointer
+// that was registered with addLeds and show() only counts frames
+
+#include <inttypes.h>
+
+// the real FastLED pulls in the arduino core
+#include <Arduino.h>
+
+// predefined hues from FastLED pixeltypes.h
+typedef enum {
+  HUE_RED = 0,
+  HUE_ORANGE = 32,
+  HUE_YELLOW = 64,
+  HUE_GREEN = 96,
+  HUE_AQUA = 128,
+  HUE_BLUE = 160,
+  HUE_PURPLE = 192,
+  HUE_PINK = 224
+} HSVHue;
+
+typedef uint8_t fract8;
+
+// from FastLED lib8tion/scale8.h, it's declared here too so anything
+// else named scale8 fails to build on the host like it does on the chip
+static inline uint8_t scale8(uint8_t i, fract8 scale)
+{
+  return (((uint16_t)i) * (1 + (uint16_t)(scale))) >> 8;
+}
+
+struct CRGB
+{
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+};
+
+template<uint8_t DATA_PIN> class NEOPIXEL {};
+
+class CFastLED
+{
+public:
+  CFastLED() : m_leds(nullptr), m_numLeds(0), m_numShows(0) {}
+
+  template<template<uint8_t DATA_PIN> class CHIPSET, uint8_t DATA_PIN>
+  void addLeds(CRGB *data, int numLeds)
+  {
+    m_leds = data;
+    m_numLeds = numLeds;
+  }
+  void setMaxRefreshRate(uint16_t, bool = true) {}
+  void show() { m_numShows++; }
+
+  // host only: inspect the strip
+  const CRGB *leds() const { return m_leds; }
+  int size() const { return m_numLeds; }
+  uint64_t numShows() const { return m_numShows; }
+
+private:
+  CRGB *m_leds;
+  int m_numLeds;
+  uint64_t m_numShows;
+};
+
+extern CFastLED FastLED;
+
+#endif
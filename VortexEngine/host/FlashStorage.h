@@ -0,0 +1,81 @@
+#ifndef HOST_FLASH_STORAGE_H
+#define HOST_FLASH_STORAGE_H
+
+// Minimal stand-in for FlashStorage, the 'flash' is the ram array that
+// Storage.cpp declares, erase fills it with 0xFF like a real flash row and
+// writes can only clear bits like real flash so writing to a spot that
+// wasn't erased first shows up as corrupt data instead of working anyway.
+// Writes also go through a page buffer the same way the library drives
+// the NVM controller so a write that runs past the end of a page lands
+// in the wrong page like it would on the SAMD21
+
+#include <inttypes.h>
+#include <string.h>
+
+// the size of the pages that flash is written in
+#define FLASH_PAGE_SIZE 64
+// the size of the rows that flash is erased in
+#define FLASH_ROW_SIZE 256
+// the most rows the wear counters keep track of
+#define FLASH_MAX_ROWS 64
+
+class FlashClass
+{
+public:
+  FlashClass(const void *flash_addr = nullptr, uint32_t size = 0) :
+    flash_address(flash_addr), flash_size(size) {}
+
+  void write(const void *data) { write(flash_address, data, flash_size); }
+  void erase()                 { erase(flash_address, flash_size);       }
+  void read(void *data)        { read(flash_address, data, flash_size);  }
+
+  void write(const volatile void *flash_ptr, const void *data, uint32_t size)
+  {
+    uint8_t *dst = (uint8_t *)flash_ptr;
+    const uint8_t *src = (const uint8_t *)data;
+    bytesWritten() += size;
+    // the library loads a page worth of words counting from the pointer
+    // it was given, each word goes into the page buffer at its offset in
+    // a page and the buffer is written to the page of the last word
+    while (size) {
+      uint8_t pageBuffer[FLASH_PAGE_SIZE];
+      memset(pageBuffer, 0xFF, sizeof(pageBuffer));
+      uint8_t *last = dst;
+      for (uint32_t i = 0; i < (FLASH_PAGE_SIZE / 4) && size; ++i) {
+        uint32_t amount = (size < 4) ? size : 4;
+        memcpy(pageBuffer + ((uintptr_t)dst % FLASH_PAGE_SIZE), src, amount);
+        last = dst;
+        dst += 4;
+        src += amount;
+        size -= amount;
+      }
+      uint8_t *page = last - ((uintptr_t)last % FLASH_PAGE_SIZE);
+      for (uint32_t i = 0; i < FLASH_PAGE_SIZE; ++i) {
+        page[i] &= pageBuffer[i];
+      }
+    }
+  }
+  void erase(const volatile void *flash_ptr, uint32_t size)
+  {
+    memset((void *)flash_ptr, 0xFF, size);
+    uint32_t first = ((const uint8_t *)flash_ptr - (const uint8_t *)flash_address) / FLASH_ROW_SIZE;
+    for (uint32_t row = first; row < first + (size / FLASH_ROW_SIZE) && row < FLASH_MAX_ROWS; ++row) {
+      rowErases()[row]++;
+    }
+  }
+  void read(const volatile void *flash_ptr, void *data, uint32_t size)
+  {
+    memcpy(data, (const void *)flash_ptr, size);
+  }
+
+  // counters for the host to see how much and where the flash was
+  // written, the real library doesn't have these
+  static uint32_t &bytesWritten() { static uint32_t count = 0; return count; }
+  static uint32_t *rowErases() { static uint32_t counts[FLASH_MAX_ROWS] = { 0 }; return counts; }
+
+private:
+  const volatile void *flash_address;
+  const uint32_t flash_size;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "TestFrameworkLinux.h"
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#include <stdio.h>
+#include <time.h>
+
+// the pin the button is on, see Buttons::init()
+#define BUTTON_PIN 1
+
+bool TestFramework::m_logging = false;
+bool TestFramework::m_realtime = false;
+uint64_t TestFramework::m_curMicros = 0;
+uint64_t TestFramework::m_realtimeStart = 0;
+bool TestFramework::m_buttonPressed = false;
+
+// globals normally provided by the arduino core and libraries
+HostSerial Serial;
+CFastLED FastLED;
+
+// state of the deterministic random generator
+static uint32_t rand_state = 1;
+
+void TestFramework::printlog(const char *file, const char *func, int line, const char *msg, va_list list)
+{
+  if (!m_logging) {
+    return;
+  }
+  if (file) {
+    printf("%s:%d %s(): ", file, line, func);
+  } else if (func) {
+    printf("%s(): ", func);
+  }
+  vprintf(msg, list);
+  printf("\n");
+}
+
+static uint64_t monotonicMicros()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+}
+
+void TestFramework::setRealtime(bool realtime)
+{
+  if (realtime == m_realtime) {
+    return;
+  }
+  if (realtime) {
+    // continue on from the current virtual time
+    m_realtimeStart = monotonicMicros() - m_curMicros;
+  } else {
+    m_curMicros = curMicros();
+  }
+  m_realtime = realtime;
+}
+
+uint64_t TestFramework::curMicros()
+{
+  if (m_realtime) {
+    return monotonicMicros() - m_realtimeStart;
+  }
+  return m_curMicros;
+}
+
+void TestFramework::advanceMicros(uint64_t us)
+{
+  if (!m_realtime) {
+    m_curMicros += us;
+    return;
+  }
+  struct timespec ts;
+  ts.tv_sec = (time_t)(us / 1000000);
+  ts.tv_nsec = (long)((us % 1000000) * 1000);
+  nanosleep(&ts, nullptr);
+}
+
+unsigned long micros()
+{
+  return (unsigned long)TestFramework::curMicros();
+}
+
+unsigned long millis()
+{
+  return (unsigned long)(TestFramework::curMicros() / 1000);
+}
+
+void delay(unsigned long ms)
+{
+  TestFramework::advanceMicros((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  TestFramework::advanceMicros(us);
+}
+
+void randomSeed(unsigned long seed)
+{
+  // 0 would get stuck so always mix in a non-zero constant
+  rand_state = (uint32_t)seed ^ 0x9E3779B9;
+}
+
+long random(long howbig)
+{
+  if (howbig <= 0) {
+    return 0;
+  }
+  // xorshift32
+  rand_state ^= rand_state << 13;
+  rand_state ^= rand_state >> 17;
+  rand_state ^= rand_state << 5;
+  return (long)(rand_state % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  return howsmall + random(howbig - howsmall);
+}
+
+void pinMode(uint32_t, uint32_t)
+{
+}
+
+void digitalWrite(uint32_t, uint32_t)
+{
+}
+
+int digitalRead(uint32_t pin)
+{
+  if (pin == BUTTON_PIN) {
+    // the button is active low
+    return TestFramework::buttonPressed() ? LOW : HIGH;
+  }
+  return HIGH;
+}
+
+int analogRead(uint32_t)
+{
+  // a fixed 'floating pin' so the random seed is always the same
+  return 0;
+}
+
+void attachInterrupt(uint32_t, voidFuncPtr, uint32_t)
+{
+}
+
+void detachInterrupt(uint32_t)
+{
+}
+
+void installIRCallback(void (*)(uint32_t))
+{
+}
+
+void test_ir_mark(uint32_t duration)
+{
+  TestFramework::advanceMicros(duration);
+}
+
+void test_ir_space(uint32_t duration)
+{
+  TestFramework::advanceMicros(duration);
+}
@@ -0,0 +1,46 @@
+#ifndef TEST_FRAMEWORK_LINUX_H
+#define TEST_FRAMEWORK_LINUX_H
+
+#include <inttypes.h>
+#include <stdarg.h>
+
+// The headless linux framework, this is what the engine talks to in place
+// of the arduino hardware when built with TEST_FRAMEWORK + LINUX_FRAMEWORK
+//
+// By default time is entirely virtual, micros() only moves when the framework
+// is told to move it (or the engine sleeps) so every run is deterministic.
+// In realtime mode micros() follows the monotonic clock and sleeps are real
+class TestFramework
+{
+  // private unimplemented constructor
+  TestFramework();
+
+public:
+  // logging entry point used by Log.cpp
+  static void printlog(const char *file, const char *func, int line, const char *msg, va_list list);
+
+  // toggle whether logs are printed to stdout
+  static void setLogging(bool enabled) { m_logging = enabled; }
+
+  // switch between the virtual clock and the real monotonic clock
+  static void setRealtime(bool realtime);
+  static bool isRealtime() { return m_realtime; }
+
+  // the current time in microseconds
+  static uint64_t curMicros();
+  // advance the virtual clock, or nanosleep in realtime mode
+  static void advanceMicros(uint64_t us);
+
+  // press or release the button on the next Buttons::check()
+  static void setButtonPressed(bool pressed) { m_buttonPressed = pressed; }
+  static bool buttonPressed() { return m_buttonPressed; }
+
+private:
+  static bool m_logging;
+  static bool m_realtime;
+  static uint64_t m_curMicros;
+  static uint64_t m_realtimeStart;
+  static bool m_buttonPressed;
+};
+
+#endif
@@ -0,0 +1,1158 @@
+// Headless benchmark runner for the Vortex Engine
+//
+// Boots the engine against the host shims then plays every mode for a
+// fixed number of ticks on a virtual clock, reporting the throughput,
+// the time spent in each subsystem and the heap usage of each mode.
+
+#include "TestFrameworkLinux.h"
+
+#include "VortexEngine.h"
+#include "TimeControl.h"
+#include "Buttons.h"
+#include "Serial.h"
+#include "Memory.h"
+#include "Modes.h"
+#include "Menus.h"
+#include "Mode.h"
+#include "ModeBuilder.h"
+#include "Leds.h"
+#include "ColorTypes.h"
+#include "Colorset.h"
+#include "PatternBuilder.h"
+#include "PatternPool.h"
+#include "BitStream.h"
+#include "Compression.h"
+#include "SerialBuffer.h"
+#include "SerialBufferView.h"
+#include "Storage.h"
+#include "patterns/single/SingleLedPattern.h"
+#include "patterns/single/BracketsPattern.h"
+#include "patterns/single/TracerPattern.h"
+#include "patterns/single/BasicPattern.h"
+
+#include <FastLED.h>
+#include <FlashStorage.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+// default number of ticks to play each mode for
+#define DEFAULT_TICKS_PER_MODE 100000
+
+// number of times to cycle through all the modes when timing mode switches
+#define SWITCH_ROUNDS 100
+
+// number of samples per mode taken by the switch latency benchmark
+#define LATENCY_ROUNDS 1000
+
+// budgets for a single cold switch into any one mode, the switch
+// benchmark (-s) fails if any of the default patterns goes over
+#define SWITCH_BUDGET_US      100
+#define SWITCH_BUDGET_ALLOCS  64
+#define SWITCH_BUDGET_HEAP    4096
+
+// how far the seek benchmark (-k) seeks each pattern, two gloves that
+// are 10 seconds apart at the default tickrate
+#define SEEK_TARGET_TICKS 10000
+
+// size of the buffer streamed through by the bitstream benchmark (-b)
+// and the number of times it is filled then drained for each width
+#define BITS_BUFFER_SIZE 4096
+#define BITS_ROUNDS 200
+
+// number of times the compression benchmark (-z) compresses and
+// decompresses the saved modes when timing the codec
+#define COMPRESS_ROUNDS 2000
+
+// number of saves the storage benchmark (-w) makes, each one after
+// changing the colorset of a single mode like somebody editing a mode
+#define STORAGE_SAVES 2000
+
+// the subsystems that make up a single VortexEngine::tick()
+enum Subsystem : uint32_t
+{
+  SUB_CLOCK,
+  SUB_BUTTONS,
+  SUB_SERIAL,
+  SUB_MODES,
+  SUB_LEDS,
+
+  SUB_COUNT
+};
+
+static const char *subsystemNames[SUB_COUNT] = {
+  "clock", "buttons", "serial", "modes", "leds"
+};
+
+struct ModeStats
+{
+  uint64_t ticks;
+  uint64_t totalNs;
+  uint64_t subNs[SUB_COUNT];
+  uint64_t shows;
+  // busy/idle micros of the last full second, only real in realtime mode
+  uint32_t busyMicros;
+  uint32_t idleMicros;
+  uint32_t heapStart;
+  uint32_t heapPeak;
+  // ticks that took longer than the tickrate allows
+  uint32_t overruns;
+  // heap allocations made while playing
+  uint32_t allocs;
+};
+
+static uint64_t nowNs()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000ull) + (uint64_t)ts.tv_nsec;
+}
+
+// the cost of a back-to-back pair of nowNs() calls, this is subtracted
+// from each measurement so tiny subsystems aren't dominated by the timer
+static uint64_t timerOverheadNs = 0;
+
+static void calibrateTimer()
+{
+  const uint32_t samples = 10000;
+  uint64_t total = 0;
+  for (uint32_t i = 0; i < samples; ++i) {
+    uint64_t t0 = nowNs();
+    uint64_t t1 = nowNs();
+    total += t1 - t0;
+  }
+  timerOverheadNs = total / samples;
+}
+
+static uint64_t elapsedNs(uint64_t start, uint64_t end)
+{
+  uint64_t diff = end - start;
+  return (diff > timerOverheadNs) ? (diff - timerOverheadNs) : 0;
+}
+
+static uint32_t heapUsage()
+{
+#ifdef DEBUG_ALLOCATIONS
+  return cur_memory_usage();
+#else
+  return 0;
+#endif
+}
+
+static uint32_t heapAllocations()
+{
+#ifdef DEBUG_ALLOCATIONS
+  return total_memory_allocations();
+#else
+  return 0;
+#endif
+}
+
+static uint32_t heapPeakReset()
+{
+#ifdef DEBUG_ALLOCATIONS
+  reset_max_memory_usage();
+  return max_memory_usage();
+#else
+  return 0;
+#endif
+}
+
+static uint32_t heapPeakUsage()
+{
+#ifdef DEBUG_ALLOCATIONS
+  return max_memory_usage();
+#else
+  return 0;
+#endif
+}
+
+static uint32_t heapBlocks()
+{
+#ifdef DEBUG_ALLOCATIONS
+  return cur_memory_blocks();
+#else
+  return 0;
+#endif
+}
+
+// run one tick of the engine, this mirrors VortexEngine::tick() but
+// times each of the subsystems individually, the timestep in tickClock
+// sleeps which moves the virtual clock forward exactly one tick
+static void benchTick(ModeStats &stats)
+{
+  uint64_t t0 = nowNs();
+  Time::tickClock();
+  uint64_t t1 = nowNs();
+  Buttons::check();
+  uint64_t t2 = nowNs();
+  SerialComs::checkSerial();
+  uint64_t t3 = nowNs();
+  if (!Menus::run()) {
+    Modes::play();
+  }
+  uint64_t t4 = nowNs();
+  Leds::update();
+  uint64_t t5 = nowNs();
+
+  uint64_t subNs[SUB_COUNT] = {
+    elapsedNs(t0, t1), elapsedNs(t1, t2), elapsedNs(t2, t3),
+    elapsedNs(t3, t4), elapsedNs(t4, t5)
+  };
+  for (uint32_t i = 0; i < SUB_COUNT; ++i) {
+    stats.subNs[i] += subNs[i];
+    stats.totalNs += subNs[i];
+  }
+  stats.ticks++;
+
+  uint32_t heap = heapUsage();
+  if (heap > stats.heapPeak) {
+    stats.heapPeak = heap;
+  }
+}
+
+static void benchMode(ModeStats &stats, uint64_t numTicks)
+{
+  memset(&stats, 0, sizeof(stats));
+  stats.heapStart = stats.heapPeak = heapUsage();
+  uint64_t startShows = FastLED.numShows();
+  uint32_t startOverruns = Time::totalOverruns();
+  uint32_t startAllocs = heapAllocations();
+  for (uint64_t i = 0; i < numTicks; ++i) {
+    benchTick(stats);
+  }
+  stats.shows = FastLED.numShows() - startShows;
+  stats.busyMicros = Time::busyMicros();
+  stats.idleMicros = Time::idleMicros();
+  stats.overruns = Time::totalOverruns() - startOverruns;
+  stats.allocs = heapAllocations() - startAllocs;
+}
+
+// time switching between modes and randomizing colorsets, along with
+// how many allocations they cause, how many heap blocks stay live and
+// how much of the pattern pool was needed,
+// a few ticks are played between switches like somebody clicking through
+static void benchSwitches()
+{
+  uint32_t switches = Modes::numModes() * SWITCH_ROUNDS;
+  uint32_t allocs = 0;
+  uint64_t ns = 0;
+  for (uint32_t i = 0; i < switches; ++i) {
+    for (uint32_t t = 0; t < 10; ++t) {
+      VortexEngine::tick();
+    }
+    uint32_t startAllocs = heapAllocations();
+    uint64_t start = nowNs();
+    Modes::nextMode();
+    ns += nowNs() - start;
+    allocs += heapAllocations() - startAllocs;
+  }
+  printf("Mode switch: %.2f us, %.2f allocations per switch, %u live heap blocks\n",
+    (double)ns / 1000.0 / switches, (double)allocs / switches, heapBlocks());
+
+  Colorset set;
+  const uint32_t rounds = 10000;
+  uint32_t startAllocs = heapAllocations();
+  uint64_t start = nowNs();
+  for (uint32_t i = 0; i < rounds; ++i) {
+    set.randomize(MAX_COLOR_SLOTS);
+  }
+  ns = nowNs() - start;
+  printf("Colorset randomize(%u): %.2f us, %.2f allocations each\n", MAX_COLOR_SLOTS,
+    (double)ns / 1000.0 / rounds, (double)(heapAllocations() - startAllocs) / rounds);
+
+  printf("Pattern pool: %u of %u slots of %u bytes in use, high water %u, %u heap overflows\n",
+    PatternPool::used(), PatternPool::capacity(), (uint32_t)PatternPool::slotSize(),
+    PatternPool::highWater(), PatternPool::overflows());
+}
+
+static int compareNs(const void *a, const void *b)
+{
+  uint64_t lhs = *(const uint64_t *)a;
+  uint64_t rhs = *(const uint64_t *)b;
+  return (lhs > rhs) - (lhs < rhs);
+}
+
+// time every switch into each of the modes with nothing played in between
+// so the next mode is never built ahead of time, this is the full cost of
+// a switch (clear, unserialize, init) and is checked against the budgets
+static bool benchSwitchLatency()
+{
+  uint32_t numModes = Modes::numModes();
+  uint64_t *samples = (uint64_t *)calloc(numModes * LATENCY_ROUNDS, sizeof(uint64_t));
+  uint32_t *allocs = (uint32_t *)calloc(numModes, sizeof(uint32_t));
+  uint32_t *heap = (uint32_t *)calloc(numModes, sizeof(uint32_t));
+  if (!samples || !allocs || !heap) {
+    free(samples);
+    free(allocs);
+    free(heap);
+    return false;
+  }
+  for (uint32_t round = 0; round < LATENCY_ROUNDS; ++round) {
+    for (uint32_t i = 0; i < numModes; ++i) {
+      uint32_t startHeap = heapPeakReset();
+      uint32_t startAllocs = heapAllocations();
+      uint64_t start = nowNs();
+      Modes::nextMode();
+      uint64_t ns = elapsedNs(start, nowNs());
+      uint32_t index = Modes::curModeIndex();
+      samples[(index * LATENCY_ROUNDS) + round] = ns;
+      // the worst allocations and heap growth seen for this mode
+      uint32_t numAllocs = heapAllocations() - startAllocs;
+      if (numAllocs > allocs[index]) {
+        allocs[index] = numAllocs;
+      }
+      if (heapPeakUsage() - startHeap > heap[index]) {
+        heap[index] = heapPeakUsage() - startHeap;
+      }
+    }
+  }
+  bool passed = true;
+  printf("%4s %7s %10s %10s %10s %8s %8s\n", "mode", "pattern", "p50 us", "p99 us", "max us", "allocs", "heap");
+  for (uint32_t i = 0; i < numModes; ++i) {
+    // get the mode to look up the pattern
+    while (Modes::curModeIndex() != i) {
+      Modes::nextMode();
+    }
+    uint64_t *modeSamples = samples + (i * LATENCY_ROUNDS);
+    qsort(modeSamples, LATENCY_ROUNDS, sizeof(uint64_t), compareNs);
+    double p50 = (double)modeSamples[LATENCY_ROUNDS / 2] / 1000.0;
+    double p99 = (double)modeSamples[(LATENCY_ROUNDS * 99) / 100] / 1000.0;
+    double max = (double)modeSamples[LATENCY_ROUNDS - 1] / 1000.0;
+    bool over = p99 > SWITCH_BUDGET_US || allocs[i] > SWITCH_BUDGET_ALLOCS || heap[i] > SWITCH_BUDGET_HEAP;
+    printf("%4u %7u %10.2f %10.2f %10.2f %8u %8u%s\n", i, Modes::curMode()->getPatternID(),
+      p50, p99, max, allocs[i], heap[i], over ? "  OVER BUDGET" : "");
+    if (over) {
+      passed = false;
+    }
+  }
+  printf("\nBudget: p99 %u us, %u allocations, %u bytes heap: %s\n", SWITCH_BUDGET_US,
+    SWITCH_BUDGET_ALLOCS, SWITCH_BUDGET_HEAP, passed ? "PASS" : "FAIL");
+  free(samples);
+  free(allocs);
+  free(heap);
+  return passed;
+}
+
+static void printHeader()
+{
+  printf("%4s %7s %12s", "mode", "pattern", "ticks/sec");
+  for (uint32_t i = 0; i < SUB_COUNT; ++i) {
+    printf(" %8s", subsystemNames[i]);
+  }
+  printf(" %8s %8s %8s %8s %6s %8s\n", "heap", "peak", "allocs", "shows", "idle%", "overruns");
+}
+
+static void printStats(const char *label, const char *pattern, const ModeStats &stats)
+{
+  double secs = (double)stats.totalNs / 1000000000.0;
+  double tps = secs > 0 ? (double)stats.ticks / secs : 0;
+  printf("%4s %7s %12.0f", label, pattern, tps);
+  // time per subsystem is shown in nanoseconds per tick
+  for (uint32_t i = 0; i < SUB_COUNT; ++i) {
+    printf(" %8.1f", stats.ticks ? (double)stats.subNs[i] / stats.ticks : 0.0);
+  }
+  printf(" %8u %8u %8u %8llu", stats.heapStart, stats.heapPeak, stats.allocs,
+    (unsigned long long)stats.shows);
+  // the busy/idle split is only meaningful against the real clock
+  uint32_t totalMicros = stats.busyMicros + stats.idleMicros;
+  if (TestFramework::isRealtime() && totalMicros) {
+    printf(" %6.1f", (double)stats.idleMicros * 100.0 / totalMicros);
+  } else {
+    printf(" %6s", "-");
+  }
+  printf(" %8u\n", stats.overruns);
+}
+
+// run both hsv to rgb conversions across every possible hsv input and
+// report how far the fast conversion strays from the exact math
+static void benchColors()
+{
+  uint64_t mismatches = 0;
+  uint64_t totalError = 0;
+  uint32_t maxError = 0;
+  HSVColor worst;
+  for (uint32_t i = 0; i < 0x1000000; ++i) {
+    HSVColor hsv(i);
+    RGBColor exact = hsv_to_rgb_exact(hsv);
+    RGBColor fast = hsv_to_rgb_fast(hsv);
+    uint32_t error = 0;
+    for (uint32_t c = 0; c < 3; ++c) {
+      uint32_t diff = abs((int)exact.raw[c] - (int)fast.raw[c]);
+      if (diff > error) {
+        error = diff;
+      }
+    }
+    if (error) {
+      mismatches++;
+      totalError += error;
+    }
+    if (error > maxError) {
+      maxError = error;
+      worst = hsv;
+    }
+  }
+  printf("HSV to RGB: %llu of %u inputs differ, avg error %.3f, max error %u (hsv %u %u %u)\n",
+    (unsigned long long)mismatches, 0x1000000, (double)totalError / 0x1000000,
+    maxError, worst.hue, worst.sat, worst.val);
+
+  // time each conversion, the sum stops the loops from being optimized out
+  RGBColor (*conversions[2])(const HSVColor &) = { hsv_to_rgb_exact, hsv_to_rgb_fast };
+  const char *names[2] = { "exact", "fast" };
+  for (uint32_t n = 0; n < 2; ++n) {
+    uint32_t sum = 0;
+    uint64_t start = nowNs();
+    for (uint32_t i = 0; i < 0x1000000; ++i) {
+      RGBColor col = conversions[n](HSVColor(i));
+      sum += col.red + col.green + col.blue;
+    }
+    uint64_t ns = nowNs() - start;
+    printf("  %5s: %6.2f ns per conversion (sum %u)\n", names[n], (double)ns / 0x1000000, sum);
+  }
+}
+
+// time the play() of every single led pattern on its own, this is the
+// cost of one led per tick without any of the engine around it
+static void benchPatterns(uint64_t numTicks)
+{
+  Colorset set(RGB_RED, RGB_GREEN, RGB_BLUE);
+  printf("%7s %12s\n", "pattern", "ns/play");
+  for (PatternID id = PATTERN_SINGLE_FIRST; id <= PATTERN_SINGLE_LAST; ++id) {
+    SingleLedPattern *pat = PatternBuilder::makeSingle(id);
+    if (!pat) {
+      continue;
+    }
+    pat->bind(&set, LED_FIRST);
+    pat->init();
+    // the simulation moves time forward without going through the clock
+    Time::startSimulation();
+    uint64_t start = nowNs();
+    for (uint64_t i = 0; i < numTicks; ++i) {
+      pat->play();
+      Time::tickSimulation();
+    }
+    uint64_t ns = nowNs() - start;
+    Time::endSimulation();
+    printf("%7u %12.1f\n", id, (double)ns / numTicks);
+    delete pat;
+  }
+}
+
+// play a pattern every tick and check that evaluate() gives the same
+// color as play() left on the led, returns the number of mismatches
+static uint32_t verifyEvaluate(SingleLedPattern *pat, const Colorset &set, uint64_t numTicks,
+  uint64_t &playNs, uint64_t &evalNs)
+{
+  pat->bind(&set, LED_FIRST);
+  pat->init();
+  uint32_t mismatches = 0;
+  Time::startSimulation();
+  for (uint64_t i = 0; i < numTicks; ++i) {
+    uint64_t start = nowNs();
+    pat->play();
+    playNs += elapsedNs(start, nowNs());
+    start = nowNs();
+    RGBColor col = pat->evaluate(Time::getCurtime(), LED_FIRST);
+    evalNs += elapsedNs(start, nowNs());
+    if (col != Leds::getIndex(LED_FIRST)) {
+      if (!mismatches) {
+        printf("  pattern %u with %u colors differs at tick %llu\n", pat->getPatternID(),
+          set.numColors(), (unsigned long long)i);
+      }
+      mismatches++;
+    }
+    Time::tickSimulation();
+  }
+  Time::endSimulation();
+  return mismatches;
+}
+
+// check every pattern that supports evaluate() against play() across a
+// range of colorset sizes and timings, then compare how long each takes
+static bool benchEvaluate(uint64_t numTicks)
+{
+  const RGBColor colors[MAX_COLOR_SLOTS] = {
+    RGB_RED, RGB_GREEN, RGB_BLUE, RGB_WHITE, RGBColor(1, 2, 3), RGBColor(4, 5, 6),
+    RGBColor(7, 8, 9), RGBColor(10, 11, 12)
+  };
+  // on/off/gap and the like, 0 durations are the tricky case
+  const uint8_t timings[][3] = {
+    { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 1 }, { 1, 1, 1 }, { 2, 13, 0 }, { 5, 8, 35 },
+    { 1, 0, 50 }, { 3, 0, 2 }, { 20, 1, 8 }, { 2, 5, 8 },
+  };
+  const uint32_t numTimings = sizeof(timings) / sizeof(timings[0]);
+  uint32_t mismatches = 0;
+  uint32_t runs = 0;
+  uint64_t playNs = 0;
+  uint64_t evalNs = 0;
+  for (uint32_t numColors = 0; numColors <= MAX_COLOR_SLOTS; ++numColors) {
+    Colorset set;
+    for (uint32_t c = 0; c < numColors; ++c) {
+      set.addColor(colors[c]);
+    }
+    // the default patterns from the builder
+    for (PatternID id = PATTERN_SINGLE_FIRST; id <= PATTERN_SINGLE_LAST; ++id) {
+      SingleLedPattern *pat = PatternBuilder::makeSingle(id);
+      if (!pat) {
+        continue;
+      }
+      if (pat->hasFlags(PATTERN_FLAG_EVALUATE)) {
+        mismatches += verifyEvaluate(pat, set, numTicks, playNs, evalNs);
+        runs++;
+      }
+      delete pat;
+    }
+    // and each of them across all the timings
+    for (uint32_t t = 0; t < numTimings; ++t) {
+      const uint8_t *timing = timings[t];
+      SingleLedPattern *pats[3] = {
+        new BasicPattern(timing[0], timing[1], timing[2]),
+        new TracerPattern(timing[0], timing[1]),
+        new BracketsPattern(timing[0], timing[1], timing[2]),
+      };
+      for (uint32_t p = 0; p < 3; ++p) {
+        mismatches += verifyEvaluate(pats[p], set, numTicks, playNs, evalNs);
+        runs++;
+        delete pats[p];
+      }
+    }
+  }
+  uint64_t totalTicks = runs * numTicks;
+  printf("Evaluate: %u runs of %llu ticks, %u mismatches: %s\n", runs,
+    (unsigned long long)numTicks, mismatches, mismatches ? "FAIL" : "PASS");
+  printf("  play: %.1f ns/tick, evaluate: %.1f ns/tick\n",
+    (double)playNs / totalTicks, (double)evalNs / totalTicks);
+  return mismatches == 0;
+}
+
+// seek a mode of each pattern and compare it against playing another mode
+// of the same pattern tick by tick all the way to the same point, both the
+// time taken and the colors of the leds afterwards are compared
+static bool benchSeek(uint32_t targetTick)
+{
+  Colorset set(RGB_RED, RGB_GREEN, RGB_BLUE, RGB_WHITE);
+  RGBColor played[LED_COUNT];
+  bool passed = true;
+  printf("Seeking %u ticks\n", targetTick);
+  printf("%7s %12s %12s %9s %8s\n", "pattern", "play us", "seek us", "speedup", "match");
+  for (PatternID id = PATTERN_FIRST; id <= PATTERN_LAST; ++id) {
+    Mode *mode = ModeBuilder::make(id, &set);
+    Mode *seeked = ModeBuilder::make(id, &set);
+    if (!mode || !seeked) {
+      delete mode;
+      delete seeked;
+      continue;
+    }
+    // play the first mode the long way
+    uint64_t start = nowNs();
+    mode->init();
+    for (uint32_t i = 0; i < targetTick; ++i) {
+      mode->play();
+      Time::tickClock();
+    }
+    uint64_t playNs = elapsedNs(start, nowNs());
+    mode->play();
+    for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
+      played[pos] = Leds::getIndex(pos);
+    }
+    // then seek the other one to the same point from blank leds
+    Leds::clearAll();
+    start = nowNs();
+    seeked->seek(targetTick);
+    uint64_t seekNs = elapsedNs(start, nowNs());
+    seeked->play();
+    bool match = true;
+    for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
+      if (Leds::getIndex(pos) != played[pos]) {
+        match = false;
+      }
+    }
+    printf("%7u %12.1f %12.1f %8.0fx %8s\n", id, (double)playNs / 1000.0,
+      (double)seekNs / 1000.0, seekNs ? (double)playNs / seekNs : 0.0, match ? "yes" : "NO");
+    if (!match) {
+      passed = false;
+    }
+    delete mode;
+    delete seeked;
+  }
+  return passed;
+}
+
+// the original bit at a time versions of BitStream::readBits/writeBits
+// that the word at a time versions are checked and timed against
+static uint32_t readBitsSlow(BitStream &bits, uint32_t numBits)
+{
+  uint32_t val = 0;
+  if (bits.eof()) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < numBits; ++i) {
+    val = (val << 1) | bits.read1Bit();
+    if (bits.eof()) {
+      break;
+    }
+  }
+  return val;
+}
+
+static void writeBitsSlow(BitStream &bits, uint32_t numBits, uint32_t val)
+{
+  for (uint32_t i = 0; i < numBits; ++i) {
+    bits.write1Bit((val >> ((numBits - 1) - i)) & 1);
+  }
+}
+
+// fill a buffer with values of the given width then read them all back
+// again, returns the number of bytes streamed each way
+static uint32_t streamBits(BitStream &bits, uint32_t width, const uint32_t *vals,
+  uint32_t numVals, bool slow, uint64_t &writeNs, uint64_t &readNs)
+{
+  uint32_t mask = (width < 32) ? ((1u << width) - 1) : 0xFFFFFFFF;
+  uint32_t sum = 0;
+  bits.reset();
+  uint64_t start = nowNs();
+  for (uint32_t i = 0; i < numVals; ++i) {
+    if (slow) {
+      writeBitsSlow(bits, width, vals[i]);
+    } else {
+      bits.writeBits(width, vals[i]);
+    }
+  }
+  writeNs += elapsedNs(start, nowNs());
+  bits.resetPos();
+  start = nowNs();
+  for (uint32_t i = 0; i < numVals; ++i) {
+    sum += slow ? readBitsSlow(bits, width) : bits.readBits(width);
+  }
+  readNs += elapsedNs(start, nowNs());
+  // use the sum so the reads can't be optimized out
+  uint32_t expected = 0;
+  for (uint32_t i = 0; i < numVals; ++i) {
+    expected += vals[i] & mask;
+  }
+  if (sum != expected) {
+    printf("  width %u read back the wrong values\n", width);
+  }
+  return (numVals * width) / 8;
+}
+
+// check the word at a time readBits/writeBits produce exactly the same bits
+// as the old bit at a time loops for random widths, including values that
+// run off the end of the buffer, then compare the throughput of both
+static bool benchBits()
+{
+  static uint8_t fastBuf[BITS_BUFFER_SIZE];
+  static uint8_t slowBuf[BITS_BUFFER_SIZE];
+  static uint32_t vals[BITS_BUFFER_SIZE * 8];
+  uint32_t mismatches = 0;
+  srand(1);
+  // enough values to fill the whole buffer one bit at a time
+  for (uint32_t i = 0; i < BITS_BUFFER_SIZE * 8; ++i) {
+    vals[i] = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+  }
+  for (uint32_t run = 0; run < BITS_ROUNDS; ++run) {
+    // a small odd sized buffer so most runs write and read past the end
+    uint32_t size = 1 + (rand() % 64);
+    BitStream fast(fastBuf, size);
+    BitStream slow(slowBuf, size);
+    fast.reset();
+    slow.reset();
+    uint32_t widths[128];
+    for (uint32_t i = 0; i < 128; ++i) {
+      widths[i] = rand() % 33;
+      fast.writeBits(widths[i], vals[i]);
+      writeBitsSlow(slow, widths[i], vals[i]);
+    }
+    if (memcmp(fastBuf, slowBuf, size) != 0 || fast.bitpos() != slow.bitpos() ||
+        fast.eof() != slow.eof()) {
+      mismatches++;
+      continue;
+    }
+    fast.resetPos();
+    slow.resetPos();
+    for (uint32_t i = 0; i < 128; ++i) {
+      if (fast.readBits(widths[i]) != readBitsSlow(slow, widths[i]) ||
+          fast.bitpos() != slow.bitpos() || fast.eof() != slow.eof()) {
+        mismatches++;
+        break;
+      }
+    }
+  }
+  printf("BitStream: %u random runs, %u mismatches: %s\n", BITS_ROUNDS, mismatches,
+    mismatches ? "FAIL" : "PASS");
+  printf("%6s %12s %12s %12s %12s\n", "width", "write MB/s", "read MB/s",
+    "old write", "old read");
+  static const uint32_t benchWidths[] = { 1, 3, 5, 8, 13, 16, 24, 32 };
+  BitStream bits(fastBuf, BITS_BUFFER_SIZE);
+  for (uint32_t w = 0; w < sizeof(benchWidths) / sizeof(benchWidths[0]); ++w) {
+    uint32_t width = benchWidths[w];
+    uint32_t numVals = (BITS_BUFFER_SIZE * 8) / width;
+    double mb[4];
+    for (uint32_t slow = 0; slow < 2; ++slow) {
+      uint64_t writeNs = 0;
+      uint64_t readNs = 0;
+      uint64_t bytes = 0;
+      for (uint32_t round = 0; round < BITS_ROUNDS; ++round) {
+        bytes += streamBits(bits, width, vals, numVals, slow != 0, writeNs, readNs);
+      }
+      // bytes per ns * 1000 is megabytes per second
+      mb[slow * 2] = writeNs ? (double)bytes * 1000.0 / writeNs : 0.0;
+      mb[slow * 2 + 1] = readNs ? (double)bytes * 1000.0 / readNs : 0.0;
+    }
+    printf("%6u %12.1f %12.1f %12.1f %12.1f\n", width, mb[0], mb[1], mb[2], mb[3]);
+  }
+  return mismatches == 0;
+}
+
+// compress then decompress a buffer through the SerialBuffer and check
+// it comes back the same, returns the compressed size or 0 on failure
+static uint32_t roundTrip(const SerialBuffer &buf)
+{
+  SerialBuffer copy(buf);
+  if (!copy.compress()) {
+    return 0;
+  }
+  uint32_t size = copy.size();
+  if (!copy.decompress() || copy.size() != buf.size() ||
+      memcmp(copy.data(), buf.data(), buf.size()) != 0) {
+    return 0;
+  }
+  return size;
+}
+
+// compress the saved modes and each mode on its own like it would be
+// sent over IR, then time the codec on the saved modes
+static bool benchCompression()
+{
+  bool passed = true;
+  printf("%7s %8s %11s %7s\n", "mode", "bytes", "compressed", "ratio");
+  uint32_t rawTotal = 0;
+  uint32_t compressedTotal = 0;
+  for (uint32_t i = 0; i < Modes::numModes(); ++i) {
+    SerialBuffer buf;
+    Modes::curMode()->serialize(buf);
+    uint32_t size = roundTrip(buf);
+    if (!size) {
+      printf("%7u round trip FAILED\n", i);
+      passed = false;
+    } else {
+      printf("%7u %8u %11u %6.2fx\n", i, buf.size(), size, (double)buf.size() / size);
+    }
+    rawTotal += buf.size();
+    compressedTotal += size;
+    Modes::nextMode();
+  }
+  printf("%7s %8u %11u %6.2fx\n", "each", rawTotal, compressedTotal,
+    compressedTotal ? (double)rawTotal / compressedTotal : 0.0);
+  // the defaults use a random colorset, a mode of each pattern with the
+  // red green and blue colorset shows what the dictionary does for the
+  // kind of modes people actually share
+  Colorset rgb(RGB_RED, RGB_GREEN, RGB_BLUE);
+  rawTotal = 0;
+  compressedTotal = 0;
+  for (PatternID id = PATTERN_FIRST; id <= PATTERN_LAST; ++id) {
+    Mode *mode = ModeBuilder::make(id, &rgb);
+    if (!mode) {
+      continue;
+    }
+    SerialBuffer buf;
+    mode->serialize(buf);
+    delete mode;
+    uint32_t size = roundTrip(buf);
+    if (!size) {
+      printf("%7u rgb round trip FAILED\n", id);
+      passed = false;
+    }
+    rawTotal += buf.size();
+    compressedTotal += size;
+  }
+  printf("%7s %8u %11u %6.2fx\n", "rgb", rawTotal, compressedTotal,
+    compressedTotal ? (double)rawTotal / compressedTotal : 0.0);
+  SerialBuffer saved;
+  Modes::serialize(saved);
+  uint32_t savedSize = roundTrip(saved);
+  if (!savedSize) {
+    printf("%7s round trip FAILED\n", "saved");
+    return false;
+  }
+  printf("%7s %8u %11u %6.2fx (storage holds %u bytes)\n", "saved", saved.size(),
+    savedSize, (double)saved.size() / savedSize, STORAGE_SIZE);
+
+  // time the codec itself without the copies and allocations around it
+  uint32_t rawSize = saved.size();
+  uint8_t *packed = new uint8_t[rawSize];
+  uint8_t *unpacked = new uint8_t[rawSize];
+  uint32_t margin = 0;
+  uint32_t packedSize = 0;
+  uint64_t start = nowNs();
+  for (uint32_t i = 0; i < COMPRESS_ROUNDS; ++i) {
+    packedSize = Compression::compress(saved.data(), rawSize, packed, rawSize, &margin);
+  }
+  uint64_t compressNs = elapsedNs(start, nowNs());
+  start = nowNs();
+  for (uint32_t i = 0; i < COMPRESS_ROUNDS; ++i) {
+    if (!Compression::decompress(packed, packedSize, unpacked, rawSize)) {
+      passed = false;
+      break;
+    }
+  }
+  uint64_t decompressNs = elapsedNs(start, nowNs());
+  if (memcmp(unpacked, saved.data(), rawSize) != 0) {
+    passed = false;
+  }
+  delete[] packed;
+  delete[] unpacked;
+  // uncompressed bytes per ns * 1000 is megabytes per second
+  uint64_t bytes = (uint64_t)rawSize * COMPRESS_ROUNDS;
+  printf("Codec: compress %.1f MB/s, decompress %.1f MB/s, in place margin %u bytes: %s\n",
+    compressNs ? (double)bytes * 1000.0 / compressNs : 0.0,
+    decompressNs ? (double)bytes * 1000.0 / decompressNs : 0.0, margin,
+    passed ? "PASS" : "FAIL");
+  return passed;
+}
+
+// the flash array that Storage.cpp writes to
+extern uint8_t _storagedata[];
+
+// whether the modes that are loaded serialize to the given buffer
+static bool modesMatch(const SerialBuffer &expected)
+{
+  SerialBuffer buf;
+  Modes::serialize(buf);
+  return buf.size() == expected.size() && memcmp(buf.data(), expected.data(), buf.size()) == 0;
+}
+
+// serialize a mode how firmware before the versioned format did, the
+// flags then each pattern with its wire id in front of it
+static void serializeLegacyMode(const Mode &mode, SerialBuffer &buf)
+{
+  uint32_t flags = MODE_FLAG_NONE;
+  if (mode.isMultiLed()) {
+    flags = MODE_FLAG_MULTI_LED;
+  } else if (mode.isSameSingleLed()) {
+    flags = MODE_FLAG_ALL_SAME_SINGLE;
+  }
+  buf.serialize(flags);
+  for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
+    PatternBuilder::serialize(mode.getPattern(pos), buf);
+    if (flags != MODE_FLAG_NONE) {
+      break;
+    }
+  }
+}
+
+// save over and over with one mode changed each time and compare what
+// gets written and erased to the old storage which erased and rewrote
+// all of it every save, then check the modes load back after a reboot
+// and that storage written by older firmware is still loaded
+static bool benchStorage()
+{
+  bool passed = true;
+  uint32_t startBytes = FlashClass::bytesWritten();
+  uint32_t startErases = Storage::blockErases();
+  uint64_t saveNs = 0;
+  Colorset set;
+  for (uint32_t i = 0; i < STORAGE_SAVES; ++i) {
+    set.randomize(1 + (i % MAX_COLOR_SLOTS));
+    if (!Modes::curMode()) {
+      printf("Mode %u failed to load after save %u\n", Modes::curModeIndex(), i);
+      passed = false;
+      break;
+    }
+    Modes::setCurMode(Modes::curMode()->getPatternID(), &set);
+    uint64_t start = nowNs();
+    if (!Modes::saveStorage()) {
+      printf("Save %u failed\n", i);
+      passed = false;
+      break;
+    }
+    saveNs += elapsedNs(start, nowNs());
+    // play a bit so the compaction runs in the background then move on
+    for (uint32_t t = 0; t < 10; ++t) {
+      VortexEngine::tick();
+    }
+    Modes::nextMode();
+  }
+  uint32_t bytes = FlashClass::bytesWritten() - startBytes;
+  uint32_t erases = Storage::blockErases() - startErases;
+  // the old storage compressed the whole save and erased all of the rows
+  SerialBuffer saved;
+  Modes::serialize(saved);
+  // and it saved the modes in the format from before they had a version
+  SerialBufferView savedView(saved);
+  uint8_t numModes = savedView.unserialize8();
+  SerialBuffer legacyModes[NUM_MODES];
+  SerialBuffer compressed;
+  compressed.serialize(numModes);
+  for (uint8_t i = 0; i < numModes; ++i) {
+    Mode mode;
+    mode.unserialize(savedView);
+    serializeLegacyMode(mode, legacyModes[i]);
+    compressed += legacyModes[i];
+  }
+  compressed.compress();
+  uint32_t rows = STORAGE_SIZE / FLASH_ROW_SIZE;
+  uint32_t minErases = 0xFFFFFFFF;
+  uint32_t maxErases = 0;
+  for (uint32_t row = 0; row < rows; ++row) {
+    uint32_t count = FlashClass::rowErases()[row];
+    if (count < minErases) {
+      minErases = count;
+    }
+    if (count > maxErases) {
+      maxErases = count;
+    }
+  }
+  printf("Storage: %u saves, %.1f us each, log using %u of %u blocks\n", STORAGE_SAVES,
+    (double)saveNs / 1000.0 / STORAGE_SAVES, Storage::usedBlocks(), STORAGE_NUM_BLOCKS);
+  printf("  written: %.1f bytes and %.3f block erases per save\n",
+    (double)bytes / STORAGE_SAVES, (double)erases / STORAGE_SAVES);
+  printf("  old storage: %u bytes and %u row erases per save\n",
+    compressed.rawSize(), rows);
+  printf("  row erases: %u to %u per row over %u rows (old storage: %u per row)\n",
+    minErases, maxErases, rows, STORAGE_SAVES + 1);
+
+  // reboot and make sure every mode comes back the same
+  Modes::clearModes();
+  uint32_t bootHeap = heapUsage();
+  uint64_t start = nowNs();
+  Storage::init();
+  bool reloaded = Modes::loadStorage();
+  uint64_t loadNs = elapsedNs(start, nowNs());
+  uint32_t loadHeap = heapUsage() - bootHeap;
+  reloaded = reloaded && modesMatch(saved);
+  printf("  reload after reboot: %.1f us, %u bytes of heap: %s\n", (double)loadNs / 1000.0,
+    loadHeap, reloaded ? "PASS" : "FAIL");
+  passed = passed && reloaded;
+
+  // build every mode out of storage by copying each record into a buffer
+  // then again by viewing it in the flash, only compressed records still
+  // need a buffer to decompress into. Mode i is stored under key i + 1
+  uint32_t copyPeak = 0;
+  uint32_t viewPeak = 0;
+  uint32_t numViewed = 0;
+  bool built = true;
+  for (uint8_t i = 0; i < Modes::numModes(); ++i) {
+    uint32_t base = heapUsage();
+    heapPeakReset();
+    SerialBuffer copy;
+    built = built && Storage::read(i + 1, copy);
+    SerialBufferView copyView(copy);
+    Mode *mode = ModeBuilder::unserialize(copyView);
+    built = built && mode;
+    delete mode;
+    copy.clear();
+    copyPeak += heapPeakUsage() - base;
+    heapPeakReset();
+    SerialBufferView view;
+    built = built && Storage::view(i + 1, view);
+    SerialBuffer decompressed;
+    if (view.is_compressed()) {
+      built = built && decompressed.decompress(view);
+      view = SerialBufferView(decompressed);
+    } else {
+      numViewed++;
+    }
+    mode = ModeBuilder::unserialize(view);
+    built = built && mode;
+    delete mode;
+    decompressed.clear();
+    viewPeak += heapPeakUsage() - base;
+  }
+  printf("  build each mode: peak heap %u bytes copied, %u bytes viewed, %u of %u in place: %s\n",
+    copyPeak / Modes::numModes(), viewPeak / Modes::numModes(), numViewed, Modes::numModes(),
+    built ? "PASS" : "FAIL");
+  passed = passed && built;
+
+  // then put the storage back how older firmware left it
+  memset(_storagedata, 0xFF, STORAGE_SIZE);
+  memcpy(_storagedata, compressed.rawData(), compressed.rawSize());
+  Storage::init();
+  bool migrated = Modes::loadStorage() && modesMatch(saved) && Storage::usedBlocks() > 0;
+  // the power going out before the header is written leaves the modes
+  // without a header, the old buffer must still be there to load again
+  migrated = migrated && Storage::remove(0);
+  Storage::init();
+  migrated = migrated && Modes::loadStorage() && modesMatch(saved);
+  Storage::init();
+  migrated = migrated && Modes::loadStorage() && modesMatch(saved);
+  printf("  load and move over older storage: %s\n", migrated ? "PASS" : "FAIL");
+
+  // then write each mode in the older format to the log like firmware
+  // from before the versioned format did, the modes must be rewritten
+  // in the new format on the first boot and left alone after that
+  memset(_storagedata, 0xFF, STORAGE_SIZE);
+  Storage::init();
+  SerialBuffer header;
+  header.serialize(numModes);
+  bool upgraded = Storage::write(0, header);
+  for (uint8_t i = 0; i < numModes; ++i) {
+    upgraded = upgraded && Storage::write(i + 1, legacyModes[i]);
+  }
+  Storage::init();
+  upgraded = upgraded && Modes::loadStorage() && modesMatch(saved);
+  uint32_t upgradeBytes = FlashClass::bytesWritten();
+  Storage::init();
+  upgraded = upgraded && Modes::loadStorage() && modesMatch(saved);
+  upgraded = upgraded && FlashClass::bytesWritten() == upgradeBytes;
+  SerialBuffer upgradedMode;
+  upgraded = upgraded && Storage::read(1, upgradedMode) &&
+    upgradedMode.data()[0] == (MODE_VERSION_BIT | MODE_VERSION);
+  printf("  upgrade modes to version %u once: %s\n", MODE_VERSION, upgraded ? "PASS" : "FAIL");
+  return passed && migrated && upgraded;
+}
+
+static void usage(const char *prog)
+{
+  printf("Usage: %s [options]\n", prog);
+  printf("  -n <ticks>   ticks to play per mode (default %u)\n", DEFAULT_TICKS_PER_MODE);
+  printf("  -m <index>   only benchmark a single mode\n");
+  printf("  -r           run against the real clock (1 tick per ms)\n");
+  printf("  -c           compare the hsv to rgb conversions then exit\n");
+  printf("  -s           time cold switches into each mode against the budgets then exit\n");
+  printf("  -l           time play() of each single led pattern then exit\n");
+  printf("  -e           check evaluate() against play() of each pattern then exit\n");
+  printf("  -k           time seeking each pattern %u ticks against playing it then exit\n", SEEK_TARGET_TICKS);
+  printf("  -b           check and time the bitstream reads and writes then exit\n");
+  printf("  -z           check and time compressing the default modes then exit\n");
+  printf("  -w           check and time saving modes to flash storage then exit\n");
+  printf("  -p <policy>  tick overrun policy: stretch, catchup or drop\n");
+  printf("  -v           print engine logs\n");
+  printf("  -h           show this help\n");
+}
+
+int main(int argc, char *argv[])
+{
+  uint64_t ticksPerMode = DEFAULT_TICKS_PER_MODE;
+  int onlyMode = -1;
+  bool patternsOnly = false;
+  bool switchesOnly = false;
+  bool evaluateOnly = false;
+  bool seekOnly = false;
+  bool compressOnly = false;
+  bool storageOnly = false;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "-n") && (i + 1) < argc) {
+      ticksPerMode = strtoull(argv[++i], nullptr, 10);
+    } else if (!strcmp(argv[i], "-m") && (i + 1) < argc) {
+      onlyMode = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "-r")) {
+      TestFramework::setRealtime(true);
+    } else if (!strcmp(argv[i], "-c")) {
+      benchColors();
+      return 0;
+    } else if (!strcmp(argv[i], "-s")) {
+      switchesOnly = true;
+    } else if (!strcmp(argv[i], "-l")) {
+      patternsOnly = true;
+    } else if (!strcmp(argv[i], "-e")) {
+      evaluateOnly = true;
+    } else if (!strcmp(argv[i], "-k")) {
+      seekOnly = true;
+    } else if (!strcmp(argv[i], "-b")) {
+      return benchBits() ? 0 : 1;
+    } else if (!strcmp(argv[i], "-z")) {
+      compressOnly = true;
+    } else if (!strcmp(argv[i], "-w")) {
+      storageOnly = true;
+    } else if (!strcmp(argv[i], "-p") && (i + 1) < argc) {
+      const char *policy = argv[++i];
+      if (!strcmp(policy, "stretch")) {
+        Time::setOverrunPolicy(OVERRUN_STRETCH);
+      } else if (!strcmp(policy, "catchup")) {
+        Time::setOverrunPolicy(OVERRUN_CATCHUP);
+      } else if (!strcmp(policy, "drop")) {
+        Time::setOverrunPolicy(OVERRUN_DROP);
+      } else {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "-v")) {
+      TestFramework::setLogging(true);
+    } else {
+      usage(argv[0]);
+      return !strcmp(argv[i], "-h") ? 0 : 1;
+    }
+  }
+
+  calibrateTimer();
+
+  if (patternsOnly) {
+    benchPatterns(ticksPerMode);
+    return 0;
+  }
+  if (evaluateOnly) {
+    return benchEvaluate(ticksPerMode) ? 0 : 1;
+  }
+
+  uint32_t bootHeap = heapUsage();
+  uint64_t bootStart = nowNs();
+  if (!VortexEngine::init()) {
+    printf("Failed to initialize engine\n");
+    return 1;
+  }
+  uint64_t bootNs = nowNs() - bootStart;
+  printf("Boot: %.1f us, heap %u -> %u bytes, %u modes\n",
+    (double)bootNs / 1000.0, bootHeap, heapUsage(), Modes::numModes());
+  if (switchesOnly) {
+    bool passed = benchSwitchLatency();
+    VortexEngine::cleanup();
+    return passed ? 0 : 1;
+  }
+  if (seekOnly) {
+    bool passed = benchSeek(SEEK_TARGET_TICKS);
+    VortexEngine::cleanup();
+    return passed ? 0 : 1;
+  }
+  if (compressOnly) {
+    bool passed = benchCompression();
+    VortexEngine::cleanup();
+    return passed ? 0 : 1;
+  }
+  if (storageOnly) {
+    bool passed = benchStorage();
+    VortexEngine::cleanup();
+    return passed ? 0 : 1;
+  }
+
+  printf("Ticks per mode: %llu (subsystem times in ns/tick)\n\n",
+    (unsigned long long)ticksPerMode);
+
+  printHeader();
+  ModeStats total;
+  memset(&total, 0, sizeof(total));
+  for (uint32_t i = 0; i < Modes::numModes(); ++i) {
+    if (onlyMode < 0 || (uint32_t)onlyMode == i) {
+      ModeStats stats;
+      benchMode(stats, ticksPerMode);
+      char label[16];
+      char pattern[16];
+      snprintf(label, sizeof(label), "%u", i);
+      snprintf(pattern, sizeof(pattern), "%u", Modes::curMode()->getPatternID());
+      printStats(label, pattern, stats);
+      // accumulate the totals
+      total.ticks += stats.ticks;
+      total.totalNs += stats.totalNs;
+      for (uint32_t s = 0; s < SUB_COUNT; ++s) {
+        total.subNs[s] += stats.subNs[s];
+      }
+      total.shows += stats.shows;
+      total.overruns += stats.overruns;
+      total.allocs += stats.allocs;
+      if (stats.heapPeak > total.heapPeak) {
+        total.heapPeak = stats.heapPeak;
+      }
+    }
+    Modes::nextMode();
+  }
+  total.heapStart = heapUsage();
+  printStats("all", "-", total);
+  printf("\n");
+
+  benchSwitches();
+
+  VortexEngine::cleanup();
+  return 0;
+}
@@ -95,17 +95,33 @@ void BitStream::write1Bit(uint8_t bit)
   }
 }
 
-uint8_t BitStream::readBits(uint32_t numBits)
+// reads numBits into the LSB in sequential order
+uint32_t BitStream::readBits(uint32_t numBits)
 {
-  uint32_t val = 0;
   if (m_buf_eof) {
     return 0;
   }
-  for (uint32_t i = 0; i < numBits; ++i) {
-    val = (val << 1) | read1Bit();
-    if (m_buf_eof) {
-      break;
+  if (numBits > 32) {
+    numBits = 32;
+  }
+  // only read as far as the end of the buffer
+  uint32_t bitsLeft = (m_buf_size * 8) - m_bit_pos;
+  if (numBits > bitsLeft) {
+    numBits = bitsLeft;
+  }
+  uint32_t val = 0;
+  // take as many bits as possible out of each byte at once, at most the
+  // rest of the current byte, then shift them into the bottom of the value
+  while (numBits > 0) {
+    uint32_t bitOffset = m_bit_pos % 8;
+    uint32_t chunk = 8 - bitOffset;
+    if (chunk > numBits) {
+      chunk = numBits;
     }
+    uint32_t bits = (m_buf[m_bit_pos / 8] >> (8 - bitOffset - chunk)) & ((1 << chunk) - 1);
+    val = (val << chunk) | bits;
+    m_bit_pos += chunk;
+    numBits -= chunk;
   }
   if (m_bit_pos >= (m_buf_size * 8)) {
     m_buf_eof = true;
@@ -113,15 +129,44 @@ uint8_t BitStream::readBits(uint32_t numBits)
   return val;
 }
 
-// writes numBits of the LSB in sequential order
+// writes numBits of the LSB in sequential order, for ex if numBits is 4:
+//
+//  00000000 01010101
+//               ^^^^
+//            write these four bits from left to right
+//
+// NOTE: the bits are OR'd into the buffer so it must start out zeroed
 void BitStream::writeBits(uint32_t numBits, uint32_t val)
 {
-  for (uint32_t i = 0; i < numBits; ++i) {
-    // write each bit in order, for ex if numBits is 4:
-    //
-    //  00000000 01010101
-    //               ^^^^
-    //            write these four bits from left to right
-    write1Bit((val >> ((numBits - 1) - i)) & 1);
+  if (m_buf_eof) {
+    return;
+  }
+  if (numBits > 32) {
+    numBits = 32;
+  }
+  uint32_t bitsLeft = (m_buf_size * 8) - m_bit_pos;
+  if (!bitsLeft) {
+    m_buf_eof = true;
+    return;
+  }
+  // only the leftmost bits that fit before the end of the buffer are written
+  if (numBits > bitsLeft) {
+    val >>= (numBits - bitsLeft);
+    numBits = bitsLeft;
+  }
+  // fill the rest of the current byte with as many bits as fit at once
+  while (numBits > 0) {
+    uint32_t bitOffset = m_bit_pos % 8;
+    uint32_t chunk = 8 - bitOffset;
+    if (chunk > numBits) {
+      chunk = numBits;
+    }
+    uint32_t bits = (val >> (numBits - chunk)) & ((1 << chunk) - 1);
+    m_buf[m_bit_pos / 8] |= bits << (8 - bitOffset - chunk);
+    m_bit_pos += chunk;
+    numBits -= chunk;
+  }
+  if (m_bit_pos >= (m_buf_size * 8)) {
+    m_buf_eof = true;
   }
 }
\ No newline at end of file
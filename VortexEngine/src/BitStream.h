@@ -3,7 +3,8 @@
 
 #include <inttypes.h>
 
-// A class to read/write a buffer of bits one bit at a time
+// A class to read/write a buffer of bits, the bits of each byte are
+// read and written from the most significant bit to the least
 class BitStream
 {
 public:
@@ -25,8 +26,9 @@ public:
   // read write a single bit in LSB
   uint8_t read1Bit();
   void write1Bit(uint8_t bit);
-  // read/write multiple bits from left to right at LSB
-  uint8_t readBits(uint32_t numBits);
+  // read/write up to 32 bits from left to right at LSB, if the end of the
+  // buffer is reached part way then only the bits up to the end are moved
+  uint32_t readBits(uint32_t numBits);
   void writeBits(uint32_t numBits, uint32_t val);
 
   // metainfo about the bit stream
@@ -1,5 +1,6 @@
 #include "ColorTypes.h"
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
 
 #include <Arduino.h>
 
@@ -145,13 +146,61 @@ RGBColor::RGBColor(const HSVColor &rhs)
 
 RGBColor &RGBColor::operator=(const HSVColor &rhs)
 {
+#ifdef HSV_TO_RGB_FAST
+  *this = hsv_to_rgb_fast(rhs);
+#else
+  *this = hsv_to_rgb_exact(rhs);
+#endif
+  return *this;
+}
+
+bool RGBColor::operator==(const RGBColor &other) const
+{
+  return red == other.red && green == other.green && blue == other.blue;
+}
+
+bool RGBColor::operator!=(const RGBColor &other) const
+{
+  return !(*this == other);
+}
+
+bool RGBColor::empty() const
+{
+  return !red && !green && !blue;
+}
+
+void RGBColor::clear()
+{
+  red = 0;
+  green = 0;
+  blue = 0;
+}
+
+void RGBColor::serialize(SerialBuffer &buffer) const
+{
+  buffer.serialize(red);
+  buffer.serialize(green);
+  buffer.serialize(blue);
+}
+
+void RGBColor::unserialize(SerialBufferView &buffer)
+{
+  buffer.unserialize(&red);
+  buffer.unserialize(&green);
+  buffer.unserialize(&blue);
+}
+
+
+// ==========
+//  HSV to RGB
+
+RGBColor hsv_to_rgb_exact(const HSVColor &rhs)
+{
+  uint8_t red, green, blue;
   unsigned char region, remainder, p, q, t;
 
   if (rhs.sat == 0) {
-    red = rhs.val;
-    green = rhs.val;
-    blue = rhs.val;
-    return *this;
+    return RGBColor(rhs.val, rhs.val, rhs.val);
   }
 
   region = rhs.hue / 43;
@@ -181,32 +230,78 @@ RGBColor &RGBColor::operator=(const HSVColor &rhs)
     red = rhs.val; green = p; blue = q;
     break;
   }
-  return *this;
+  return RGBColor(red, green, blue);
 }
 
-bool RGBColor::empty() const
+// The rainbow table is the exact conversion of every hue at full sat and
+// val, it's generated by the compiler (this is C++11 so constexpr functions
+// can only be a single return) then expanded into const arrays in flash
+
+// the region of the hue and how far into the region the hue is
+constexpr uint8_t hue_region(uint32_t hue)
 {
-  return !red && !green && !blue;
+  return hue / 43;
 }
-
-void RGBColor::clear()
+constexpr uint8_t hue_remainder(uint32_t hue)
 {
-  red = 0;
-  green = 0;
-  blue = 0;
+  return (hue - (hue_region(hue) * 43)) * 6;
 }
 
-void RGBColor::serialize(SerialBuffer &buffer) const
+// the falling and rising channels, the third channel is either 255 or 0
+constexpr uint8_t hue_fall(uint32_t hue)
 {
-  buffer.serialize(red);
-  buffer.serialize(green);
-  buffer.serialize(blue);
+  return (255 * (255 - ((255 * hue_remainder(hue)) >> 8))) >> 8;
+}
+constexpr uint8_t hue_rise(uint32_t hue)
+{
+  return (255 * (255 - ((255 * (255 - hue_remainder(hue))) >> 8))) >> 8;
 }
 
-void RGBColor::unserialize(SerialBuffer &buffer)
+// pick the channel values for each region like the exact switch does
+constexpr uint8_t hue_red(uint32_t hue)
 {
-  buffer.unserialize(&red);
-  buffer.unserialize(&green);
-  buffer.unserialize(&blue);
+  return (hue_region(hue) == 0 || hue_region(hue) >= 5) ? 255 :
+    (hue_region(hue) == 1) ? hue_fall(hue) :
+    (hue_region(hue) == 4) ? hue_rise(hue) : 0;
+}
+constexpr uint8_t hue_green(uint32_t hue)
+{
+  return (hue_region(hue) == 1 || hue_region(hue) == 2) ? 255 :
+    (hue_region(hue) == 0) ? hue_rise(hue) :
+    (hue_region(hue) == 3) ? hue_fall(hue) : 0;
 }
+constexpr uint8_t hue_blue(uint32_t hue)
+{
+  return (hue_region(hue) == 3 || hue_region(hue) == 4) ? 255 :
+    (hue_region(hue) == 2) ? hue_rise(hue) :
+    (hue_region(hue) >= 5) ? hue_fall(hue) : 0;
+}
+
+// a list of indexes 0 to N - 1 to expand the table with
+template<uint32_t... Is> struct HueIndexes {};
+template<uint32_t N, uint32_t... Is> struct MakeHueIndexes : MakeHueIndexes<N - 1, N - 1, Is...> {};
+template<uint32_t... Is> struct MakeHueIndexes<0, Is...> { typedef HueIndexes<Is...> type; };
+
+template<typename T> struct RainbowTable;
+template<uint32_t... Is> struct RainbowTable<HueIndexes<Is...>>
+{
+  static const uint8_t red[sizeof...(Is)];
+  static const uint8_t green[sizeof...(Is)];
+  static const uint8_t blue[sizeof...(Is)];
+};
+template<uint32_t... Is> const uint8_t RainbowTable<HueIndexes<Is...>>::red[sizeof...(Is)] = { hue_red(Is)... };
+template<uint32_t... Is> const uint8_t RainbowTable<HueIndexes<Is...>>::green[sizeof...(Is)] = { hue_green(Is)... };
+template<uint32_t... Is> const uint8_t RainbowTable<HueIndexes<Is...>>::blue[sizeof...(Is)] = { hue_blue(Is)... };
+
+typedef RainbowTable<MakeHueIndexes<256>::type> Rainbow;
 
+RGBColor hsv_to_rgb_fast(const HSVColor &rhs)
+{
+  // desaturating mixes white into the full color then val scales it
+  // all down, the full color channel always comes out as exactly val
+  uint8_t white = 255 - rhs.sat;
+  return RGBColor(
+    vscale8(vscale8(Rainbow::red[rhs.hue], rhs.sat) + white, rhs.val),
+    vscale8(vscale8(Rainbow::green[rhs.hue], rhs.sat) + white, rhs.val),
+    vscale8(vscale8(Rainbow::blue[rhs.hue], rhs.sat) + white, rhs.val));
+}
@@ -38,7 +38,24 @@
 #define HSV_HUE_PURPLE  192
 #define HSV_HUE_PINK    224
 
+// HSV to RGB Conversion
+//
+// The exact conversion divides by 43 every time which is slow on a chip
+// without a hardware divider, the fast conversion instead looks the hue up
+// in a rainbow table generated at compile time and applies sat/val with
+// scale8 math. The two can differ by a step or two of rounding, comment
+// this out to use the exact math instead
+#define HSV_TO_RGB_FAST
+
+// scale a value by x/256 where 255 leaves the value untouched, this has
+// its own name because FastLED declares a global scale8 of its own
+inline uint8_t vscale8(uint8_t val, uint8_t scale)
+{
+  return ((uint16_t)val * (1 + (uint16_t)scale)) >> 8;
+}
+
 class SerialBuffer;
+class SerialBufferView;
 class RGBColor;
 
 // todo: remake color classes here
@@ -94,11 +111,15 @@ public:
   RGBColor(const HSVColor &rhs);
   RGBColor &operator=(const HSVColor &rhs);
 
+  // equality
+  bool operator==(const RGBColor &other) const;
+  bool operator!=(const RGBColor &other) const;
+
   bool empty() const;
   void clear();
 
   void serialize(SerialBuffer &buffer) const;
-  void unserialize(SerialBuffer &buffer);
+  void unserialize(SerialBufferView &buffer);
 
   // public members
   union
@@ -113,4 +134,9 @@ public:
   };
 };
 
+// the two hsv to rgb conversions, RGBColor uses the one that is
+// selected by HSV_TO_RGB_FAST but both are always available
+RGBColor hsv_to_rgb_exact(const HSVColor &rhs);
+RGBColor hsv_to_rgb_fast(const HSVColor &rhs);
+
 #endif
@@ -1,6 +1,7 @@
 #include "Colorset.h"
 
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
 #include "Memory.h"
 
 #include "Log.h"
@@ -10,10 +11,39 @@
 
 #define INDEX_NONE UINT8_MAX
 
+// the first byte of a serialized colorset holds the number of colors in
+// the low bits and how the colors are encoded in the high bits, older
+// firmware only wrote the count so its colorsets are always plain rgb
+#define COLORSET_COUNT_MASK     0x0F
+// a byte follows with a bit for each color that is written as a single
+// byte index into the shared palette instead of 3 bytes of rgb
+#define COLORSET_FLAG_INDEXED   (1 << 7)
+
+// colors that show up in a lot of colorsets, this is part of the save
+// format so only ever add to the end of it
+static const uint32_t sharedPalette[] = {
+  RGB_OFF, RGB_WHITE, RGB_RED, RGB_ORANGE, RGB_YELLOW, RGB_GREEN,
+  RGB_TEAL, RGB_CYAN, RGB_BLUE, RGB_PURPLE, RGB_BLANK, 0xFFFFFF,
+  0xFF00FF, 0xFF0080, 0x8000FF, 0x0080FF,
+};
+
+#define SHARED_PALETTE_SIZE (sizeof(sharedPalette) / sizeof(sharedPalette[0]))
+
+// the index of a color in the shared palette or INDEX_NONE
+static uint8_t sharedIndex(const RGBColor &col)
+{
+  uint32_t dwVal = ((uint32_t)col.red << 16) | ((uint32_t)col.green << 8) | col.blue;
+  for (uint8_t i = 0; i < SHARED_PALETTE_SIZE; ++i) {
+    if (sharedPalette[i] == dwVal) {
+      return i;
+    }
+  }
+  return INDEX_NONE;
+}
+
 Colorset::Colorset() :
   m_palette(nullptr),
-  m_curIndex(INDEX_NONE),
-  m_numColors(0)
+  m_curIndex(INDEX_NONE)
 {
   init();
 }
@@ -43,34 +73,25 @@ Colorset::Colorset(const Colorset &other) :
 
 Colorset::~Colorset()
 {
-  clear();
-}
-
-Colorset::Colorset(Colorset &&other) noexcept :
-  m_palette(other.m_palette),
-  m_curIndex(INDEX_NONE),
-  m_numColors(other.m_numColors)
-{
-  other.m_palette = nullptr;
-  other.m_numColors = 0;
-  other.m_curIndex = INDEX_NONE;
+  release();
 }
 
 void Colorset::operator=(const Colorset &other)
 {
-  clear();
-  initPalette(other.m_numColors);
-  for (uint32_t i = 0; i < other.m_numColors; ++i) {
-    m_palette[i] = other.m_palette[i];
+  // share the other palette instead of copying the colors
+  if (m_palette != other.m_palette) {
+    release();
+    m_palette = other.m_palette;
+    if (m_palette) {
+      m_palette->refCount++;
+    }
   }
   init();
 }
 
 bool Colorset::operator==(const Colorset &other) const
 {
-  // only compare the palettes for equality
-  return (m_numColors == other.m_numColors) && 
-         (memcmp(m_palette, other.m_palette, m_numColors * sizeof(RGBColor)) == 0);
+  return equals(&other);
 }
 
 bool Colorset::operator!=(const Colorset &other) const
@@ -86,10 +107,14 @@ void Colorset::init()
 void Colorset::clear()
 {
   if (m_palette) {
-    delete[] m_palette;
-    m_palette = nullptr;
+    if (m_palette->refCount > 1) {
+      // somebody else is still using the palette
+      release();
+    } else {
+      // hang onto the palette so it can be refilled for free
+      m_palette->numColors = 0;
+    }
   }
-  m_numColors = 0;
   init();
 }
 
@@ -98,10 +123,19 @@ bool Colorset::equals(const Colorset *set) const
   if (!set) {
     return false;
   }
-  if (set->m_numColors != m_numColors) {
+  // the same palette is always equal
+  if (set->m_palette == m_palette) {
+    return true;
+  }
+  uint32_t count = numColors();
+  if (set->numColors() != count) {
     return false;
   }
-  return (memcmp(m_palette, set->m_palette, m_numColors * sizeof(RGBColor)) == 0);
+  if (!count) {
+    // one of them is an empty palette the other is no palette
+    return true;
+  }
+  return (memcmp(m_palette->colors, set->m_palette->colors, count * sizeof(RGBColor)) == 0);
 }
 
 RGBColor Colorset::operator[](int index) const
@@ -112,28 +146,14 @@ RGBColor Colorset::operator[](int index) const
 // add a single color
 bool Colorset::addColor(RGBColor col)
 {
-  if (m_numColors >= MAX_COLOR_SLOTS) {
+  if (numColors() >= MAX_COLOR_SLOTS) {
     return false;
   }
-  // allocate a new palette one larger than before
-  RGBColor *temp = new RGBColor[m_numColors + 1];
-  if (!temp) {
+  if (!makeUnique()) {
     return false;
   }
-  // if there is already some colors in the palette
-  if (m_numColors && m_palette) {
-    // copy over existing colors
-    for (uint32_t i = 0; i < m_numColors; ++i) { 
-      temp[i] = m_palette[i];
-    }
-    // and delete the existing palette
-    delete[] m_palette;
-  }
-  // reassign new palette
-  m_palette = temp;
   // insert new color and increment number of colors
-  m_palette[m_numColors] = col;
-  m_numColors++;
+  m_palette->colors[m_palette->numColors++] = col;
   return true;
 }
 
@@ -155,17 +175,13 @@ bool Colorset::addColorByHueRandSV(uint8_t hue)
 
 void Colorset::removeColor(uint32_t index)
 {
-  if (index >= m_numColors) {
+  if (index >= numColors() || !makeUnique()) {
     return;
   }
-  for (uint8_t i = index; i < (m_numColors - 1); ++i) {
-    m_palette[i] = m_palette[i + 1];
-  }
-  m_palette[--m_numColors].clear();
-  if (!m_numColors) {
-    delete[] m_palette;
-    m_palette = nullptr;
+  for (uint8_t i = index; i < (m_palette->numColors - 1); ++i) {
+    m_palette->colors[i] = m_palette->colors[i + 1];
   }
+  m_palette->colors[--m_palette->numColors].clear();
 }
 
 // create a set of truely random colors
@@ -249,10 +265,10 @@ void Colorset::randomizeEvenlySpaced(uint32_t spaces)
 // get a color from the colorset
 RGBColor Colorset::get(uint32_t index) const
 {
-  if (index >= m_numColors || !m_palette) {
+  if (index >= numColors()) {
     return RGBColor(0, 0, 0);
   }
-  return m_palette[index];
+  return m_palette->colors[index];
 }
 
 // set an rgb color in a slot, or add a new color if you specify
@@ -261,26 +277,22 @@ void Colorset::set(uint32_t index, RGBColor col)
 {
   // special case for 'setting' a color at the edge of the palette,
   // ie adding a new color when you set an index higher than the max
-  if (index >= m_numColors) {
+  if (index >= numColors()) {
     if (!addColor(col)) {
       ERROR_LOGF("Failed to add new color at index %u", index);
     }
     return;
   }
-  if (!m_palette) {
-    // should be impossible because if the index is less than
-    // the number of colors then there must be non-zero number
-    // of colors which means the palette should be initialized
-    ERROR_LOGF("Programmer error setting color index %u with no palette", index);
+  if (!makeUnique()) {
     return;
   }
-  m_palette[index] = col;
+  m_palette->colors[index] = col;
 }
 
 // skip some amount of colors
 void Colorset::skip(int32_t amount)
 {
-  if (!m_numColors || !m_palette) {
+  if (!numColors()) {
     return;
   }
   // if the colorset hasn't started yet
@@ -289,35 +301,35 @@ void Colorset::skip(int32_t amount)
   }
 
   // first modulate the amount to skip to be within +/- the number of colors
-  amount %= (int32_t)m_numColors;
+  amount %= (int32_t)numColors();
 
   // max = 3
   // m_curIndex = 2
   // amount = -10
-  m_curIndex = ((int32_t)m_curIndex + (int32_t)amount) % (int32_t)m_numColors;
-  if (m_curIndex > m_numColors) { // must have wrapped
+  m_curIndex = ((int32_t)m_curIndex + (int32_t)amount) % (int32_t)numColors();
+  if (m_curIndex > numColors()) { // must have wrapped
     // simply wrap it back
-    m_curIndex += m_numColors;
+    m_curIndex += numColors();
   }
 }
 
 RGBColor Colorset::cur()
 {
-  if (m_curIndex >= m_numColors || !m_palette) {
+  if (m_curIndex >= numColors()) {
     return RGBColor(0, 0, 0);
   }
   if (m_curIndex == INDEX_NONE) {
-    return m_palette[0];
+    return m_palette->colors[0];
   }
-  return m_palette[m_curIndex];
+  return m_palette->colors[m_curIndex];
 }
 
 void Colorset::setCurIndex(uint8_t index)
 {
-  if (!m_numColors) {
+  if (!numColors()) {
     return;
   }
-  if (index > (m_numColors - 1)) {
+  if (index > (numColors() - 1)) {
     return;
   }
   m_curIndex = index;
@@ -325,7 +337,7 @@ void Colorset::setCurIndex(uint8_t index)
 
 RGBColor Colorset::getPrev()
 {
-  if (!m_numColors || !m_palette) {
+  if (!numColors()) {
     return RGB_OFF;
   }
   // handle wrapping at 0
@@ -335,12 +347,12 @@ RGBColor Colorset::getPrev()
     m_curIndex--;
   }
   // return the color
-  return m_palette[m_curIndex];
+  return m_palette->colors[m_curIndex];
 }
 
 RGBColor Colorset::getNext()
 {
-  if (!m_numColors || !m_palette) {
+  if (!numColors()) {
     return RGB_OFF;
   }
   // iterate current index, let it wrap at max uint8
@@ -348,19 +360,19 @@ RGBColor Colorset::getNext()
   // then modulate the result within max colors
   m_curIndex %= numColors();
   // return the color
-  return m_palette[m_curIndex];
+  return m_palette->colors[m_curIndex];
 }
 
 // peek at the next color but don't iterate
 RGBColor Colorset::peekNext() const
 {
-  if (!m_numColors || !m_palette) {
+  if (!numColors()) {
     return RGB_OFF;
   }
   // get index of the next color
   uint32_t nextIndex = (m_curIndex + 1) % numColors();
   // return the color
-  return m_palette[nextIndex];
+  return m_palette->colors[nextIndex];
 }
 
 bool Colorset::onStart() const
@@ -370,40 +382,126 @@ bool Colorset::onStart() const
 
 bool Colorset::onEnd() const
 {
-  if (!m_numColors) {
+  if (!numColors()) {
     return false;
   }
-  return (m_curIndex == m_numColors - 1);
+  return (m_curIndex == numColors() - 1);
 }
 
 void Colorset::serialize(SerialBuffer &buffer) const
 {
-  buffer.serialize(m_numColors);
-  for (uint32_t i = 0; i < m_numColors; ++i) {
-    m_palette[i].serialize(buffer);
+  uint8_t count = numColors();
+  // each color found in the shared palette is 2 bytes smaller but the
+  // mask costs a byte so it's only used when it saves something
+  uint8_t indexed = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (sharedIndex(m_palette->colors[i]) != INDEX_NONE) {
+      indexed |= (1 << i);
+    }
+  }
+  if (!indexed) {
+    buffer.serialize(count);
+    for (uint32_t i = 0; i < count; ++i) {
+      m_palette->colors[i].serialize(buffer);
+    }
+    return;
+  }
+  buffer.serialize((uint8_t)(count | COLORSET_FLAG_INDEXED));
+  buffer.serialize(indexed);
+  for (uint32_t i = 0; i < count; ++i) {
+    if (indexed & (1 << i)) {
+      buffer.serialize(sharedIndex(m_palette->colors[i]));
+    } else {
+      m_palette->colors[i].serialize(buffer);
+    }
+  }
+}
+
+uint32_t Colorset::serializedSize() const
+{
+  uint32_t count = numColors();
+  uint32_t size = 1 + (count * 3);
+  uint32_t indexed = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (sharedIndex(m_palette->colors[i]) != INDEX_NONE) {
+      indexed++;
+    }
+  }
+  if (indexed) {
+    // the mask then 1 byte instead of 3 for each indexed color
+    size += 1 - (indexed * 2);
   }
+  return size;
 }
 
-void Colorset::unserialize(SerialBuffer &buffer)
+void Colorset::unserialize(SerialBufferView &buffer)
 {
-  buffer.unserialize(&m_numColors);
-  initPalette(m_numColors);
-  for (uint32_t i = 0; i < m_numColors; ++i) {
-    m_palette[i].unserialize(buffer);
+  clear();
+  uint8_t header = 0;
+  buffer.unserialize(&header);
+  uint8_t count = header & COLORSET_COUNT_MASK;
+  // the colors past the last slot are dropped but still skipped over so
+  // whatever comes after the colorset is read from the right place, the
+  // mask only covers the slots so those are always plain rgb
+  uint32_t surplus = 0;
+  if (count > MAX_COLOR_SLOTS) {
+    ERROR_LOGF("Colorset has too many colors: %u", count);
+    surplus = (count - MAX_COLOR_SLOTS) * 3;
+    count = MAX_COLOR_SLOTS;
+  }
+  uint8_t indexed = 0;
+  if (header & COLORSET_FLAG_INDEXED) {
+    buffer.unserialize(&indexed);
+  }
+  if (!count || !makeUnique()) {
+    buffer.skip(surplus);
+    return;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    if (!(indexed & (1 << i))) {
+      m_palette->colors[i].unserialize(buffer);
+      continue;
+    }
+    uint8_t index = buffer.unserialize8();
+    if (index < SHARED_PALETTE_SIZE) {
+      m_palette->colors[i] = sharedPalette[index];
+    }
   }
+  m_palette->numColors = count;
+  buffer.skip(surplus);
 }
 
-void Colorset::initPalette(uint32_t numColors)
+bool Colorset::makeUnique()
 {
+  if (m_palette && m_palette->refCount == 1) {
+    // already the only owner
+    return true;
+  }
+  Palette *palette = new Palette();
+  if (!palette) {
+    ERROR_OUT_OF_MEMORY();
+    return false;
+  }
+  palette->refCount = 1;
   if (m_palette) {
-    delete[] m_palette;
+    // copy the colors out of the shared palette
+    palette->numColors = m_palette->numColors;
+    for (uint32_t i = 0; i < m_palette->numColors; ++i) {
+      palette->colors[i] = m_palette->colors[i];
+    }
+    release();
   }
-  //m_palette = (RGBColor *)vcalloc(numColors, sizeof(RGBColor));
-  m_palette = new RGBColor[numColors];
+  m_palette = palette;
+  return true;
+}
+
+void Colorset::release()
+{
   if (!m_palette) {
-    ERROR_OUT_OF_MEMORY();
     return;
   }
-  m_numColors = numColors;
+  if (--m_palette->refCount == 0) {
+    delete m_palette;
+  }
+  m_palette = nullptr;
 }
-
@@ -7,7 +7,13 @@
 #define MAX_COLOR_SLOTS 8
 
 class SerialBuffer;
+class SerialBufferView;
 
+// A Colorset is a small cursor (the current index) into a palette that is
+// shared between every copy of the colorset. Copying a colorset only bumps
+// the palette reference count so the per-led patterns of a mode all point
+// at a single palette, the palette is only duplicated when one of the
+// copies is changed while it's still being shared (copy on write)
 class Colorset
 {
 public:
@@ -19,9 +25,6 @@ public:
     RGBColor c7 = RGB_OFF, RGBColor c8 = RGB_OFF);
   ~Colorset();
 
-  // move constructor
-  Colorset(Colorset &&other) noexcept;
-
   // copy and assignment operators
   Colorset(const Colorset &other);
   void operator=(const Colorset &other);
@@ -99,7 +102,7 @@ public:
   RGBColor peekNext() const;
 
   // the number of colors in the palette
-  uint32_t numColors() const { return m_numColors; }
+  uint32_t numColors() const { return m_palette ? m_palette->numColors : 0; }
 
   // whether the colorset is currently on the first color or last color
   bool onStart() const;
@@ -107,19 +110,33 @@ public:
 
   // serialize the colorset to save/load
   void serialize(SerialBuffer &buffer) const;
-  void unserialize(SerialBuffer &buffer);
+  void unserialize(SerialBufferView &buffer);
+  // the number of bytes serialize writes
+  uint32_t serializedSize() const;
 
 private:
-  // pre-allocate the palette
-  void initPalette(uint32_t numColors);
-
-  // palette of colors
-  RGBColor *m_palette;
+  // the shared palette of colors
+  struct Palette
+  {
+    // the number of colorsets pointing at this palette
+    uint16_t refCount;
+    // the actual number of colors in the palette
+    uint8_t numColors;
+    // the colors, stored inline so the palette is a single allocation
+    RGBColor colors[MAX_COLOR_SLOTS];
+  };
+
+  // make sure this colorset has a palette that nobody else is
+  // pointing at so that it can be changed, false if out of memory
+  bool makeUnique();
+  // let go of the palette and delete it if nobody else is using it
+  void release();
+
+  // palette of colors, shared by every copy of this colorset
+  Palette *m_palette;
   // the current index, starts at UINT8_MAX so that
   // the very first call to getNext will iterate to 0
   uint8_t m_curIndex;
-  // the actual number of colors in the set
-  uint8_t m_numColors;
 };
 
 #endif
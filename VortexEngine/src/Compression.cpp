@@ -0,0 +1,259 @@
+#include "Compression.h"
+
+#include "Log.h"
+
+#include <string.h>
+
+// the shortest match worth encoding, a match costs at least a token
+// nibble and a 2 byte offset so anything shorter isn't any smaller
+#define MIN_MATCH 4
+
+// the largest value the 4 bit literal count and match length can hold,
+// longer runs are continued in extension bytes
+#define NIBBLE_MAX 15
+
+// number of bits in the hash of the next 4 bytes used to find matches,
+// the table is kept on the stack while compressing
+#define HASH_BITS 8
+#define HASH_SIZE (1 << HASH_BITS)
+
+// the furthest back a match can reach with a 2 byte offset
+#define MAX_OFFSET 0xFFFF
+
+// bytes that show up in most serialized modes, the compressor and the
+// decompressor both act like these were output right before the data so
+// a mode can point back into them. This is part of the format, changing
+// it will break any data compressed before the change
+static const uint8_t dictionary[] = {
+  // the empty colorsets of a sequence step then the next 25 tick duration
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x19, 0x00,
+  // the pattern maps of sequence steps
+  0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x03, 0x01, 0x01, 0x03, 0x03,
+  0x03, 0xff, 0xff, 0xff, 0x03, 0xff, 0xff, 0xff, 0x03, 0xff, 0xff,
+  // the pattern params of the default patterns
+  0x19, 0x19, 0x00, 0x14, 0x00, 0x00, 0x05, 0x08, 0x23, 0x03, 0x16, 0x00,
+  0x02, 0x05, 0x08, 0x01, 0x00, 0x32, 0x02, 0x0d, 0x00, 0x05, 0x08, 0x00,
+  // common colors
+  0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00, 0xff, 0xff, 0xff, 0x00,
+  0x00, 0xff, 0x00, 0x00, 0x00, 0xff, 0xff, 0x00, 0x00,
+  // the flags and start of a mode with a red, green and blue colorset
+  0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x03,
+  0xff, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0xff
+};
+
+#define DICT_SIZE sizeof(dictionary)
+
+// the byte at position pos of the dictionary followed by the input
+static inline uint8_t historyByte(const uint8_t *in, uint32_t pos)
+{
+  return (pos < DICT_SIZE) ? dictionary[pos] : in[pos - DICT_SIZE];
+}
+
+// hash the 4 bytes at pos of the dictionary followed by the input
+static inline uint32_t hashAt(const uint8_t *in, uint32_t pos)
+{
+  uint32_t val = 0;
+  if (pos >= DICT_SIZE) {
+    memcpy(&val, in + (pos - DICT_SIZE), sizeof(val));
+  } else {
+    for (uint32_t i = 0; i < 4; ++i) {
+      val |= (uint32_t)historyByte(in, pos + i) << (i * 8);
+    }
+  }
+  return (val * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// write the extension bytes of a literal count or match length that
+// didn't fit in the nibble of the token
+static bool writeLength(uint8_t *out, uint32_t &outPos, uint32_t outLen, uint32_t len)
+{
+  if (len < NIBBLE_MAX) {
+    return true;
+  }
+  len -= NIBBLE_MAX;
+  do {
+    if (outPos >= outLen) {
+      return false;
+    }
+    uint8_t byte = (len >= 255) ? 255 : (uint8_t)len;
+    out[outPos++] = byte;
+    len -= byte;
+  } while (out[outPos - 1] == 255);
+  return true;
+}
+
+// read the extension bytes of a literal count or match length
+static bool readLength(const uint8_t *in, uint32_t &inPos, uint32_t inLen, uint32_t &len)
+{
+  if (len < NIBBLE_MAX) {
+    return true;
+  }
+  uint8_t byte;
+  do {
+    if (inPos >= inLen) {
+      return false;
+    }
+    byte = in[inPos++];
+    len += byte;
+  } while (byte == 255);
+  return true;
+}
+
+uint32_t Compression::compress(const uint8_t *in, uint32_t inLen, uint8_t *out,
+  uint32_t outLen, uint32_t *margin)
+{
+  if (!in || !out || inLen > maxInput()) {
+    return 0;
+  }
+  // positions in the history are counted from the start of the dictionary
+  // and stored plus one so that 0 can mean the slot is empty
+  uint16_t table[HASH_SIZE];
+  memset(table, 0, sizeof(table));
+  for (uint32_t pos = 0; pos + MIN_MATCH <= DICT_SIZE; ++pos) {
+    table[hashAt(in, pos)] = (uint16_t)(pos + 1);
+  }
+  uint32_t end = DICT_SIZE + inLen;
+  uint32_t pos = DICT_SIZE;
+  uint32_t anchor = DICT_SIZE;
+  uint32_t outPos = 0;
+  // the furthest the output gets ahead of the input read so far, this
+  // decides how much room decompressing in place needs
+  int32_t maxLead = 0;
+  while (pos + MIN_MATCH <= end) {
+    uint32_t hash = hashAt(in, pos);
+    uint32_t candidate = table[hash];
+    table[hash] = (uint16_t)(pos + 1);
+    if (!candidate) {
+      pos++;
+      continue;
+    }
+    // the input is never big enough for a candidate to be out of reach
+    candidate--;
+    uint32_t len = 0;
+    while ((pos + len) < end && historyByte(in, candidate + len) == historyByte(in, pos + len)) {
+      len++;
+    }
+    if (len < MIN_MATCH) {
+      pos++;
+      continue;
+    }
+    // the token, literals and match of this sequence
+    uint32_t numLiterals = pos - anchor;
+    uint32_t matchLen = len - MIN_MATCH;
+    if (outPos >= outLen) {
+      return 0;
+    }
+    uint8_t litNibble = (numLiterals < NIBBLE_MAX) ? numLiterals : NIBBLE_MAX;
+    uint8_t matchNibble = (matchLen < NIBBLE_MAX) ? matchLen : NIBBLE_MAX;
+    out[outPos++] = (litNibble << 4) | matchNibble;
+    if (!writeLength(out, outPos, outLen, numLiterals) || (outLen - outPos) < numLiterals + 2) {
+      return 0;
+    }
+    memcpy(out + outPos, in + (anchor - DICT_SIZE), numLiterals);
+    outPos += numLiterals;
+    uint16_t offset = (uint16_t)(pos - candidate);
+    out[outPos++] = offset & 0xFF;
+    out[outPos++] = offset >> 8;
+    if (!writeLength(out, outPos, outLen, matchLen)) {
+      return 0;
+    }
+    pos += len;
+    anchor = pos;
+    int32_t lead = (int32_t)(pos - DICT_SIZE) - (int32_t)outPos;
+    if (lead > maxLead) {
+      maxLead = lead;
+    }
+    // hash the end of the match too so a following run can point at it
+    if (pos - 2 + MIN_MATCH <= end) {
+      table[hashAt(in, pos - 2)] = (uint16_t)(pos - 1);
+    }
+  }
+  // the last sequence is only literals
+  uint32_t numLiterals = end - anchor;
+  if (outPos >= outLen) {
+    return 0;
+  }
+  out[outPos++] = ((numLiterals < NIBBLE_MAX) ? numLiterals : NIBBLE_MAX) << 4;
+  if (!writeLength(out, outPos, outLen, numLiterals) || (outLen - outPos) < numLiterals) {
+    return 0;
+  }
+  memcpy(out + outPos, in + (anchor - DICT_SIZE), numLiterals);
+  outPos += numLiterals;
+  if (margin) {
+    // in place the compressed data ends at inLen + margin and the output
+    // must never catch up to the part of it that hasn't been read yet
+    int32_t need = maxLead - ((int32_t)inLen - (int32_t)outPos);
+    *margin = (need > 0) ? (uint32_t)need : 0;
+  }
+  return outPos;
+}
+
+bool Compression::decompress(const uint8_t *in, uint32_t inLen, uint8_t *out,
+  uint32_t outLen)
+{
+  if (!in || !out) {
+    return false;
+  }
+  uint32_t inPos = 0;
+  uint32_t outPos = 0;
+  while (inPos < inLen) {
+    uint8_t token = in[inPos++];
+    uint32_t numLiterals = token >> 4;
+    if (!readLength(in, inPos, inLen, numLiterals)) {
+      return false;
+    }
+    if (numLiterals > (inLen - inPos) || numLiterals > (outLen - outPos)) {
+      return false;
+    }
+    // the input may be sitting further along the same buffer so the copy
+    // has to allow overlap
+    memmove(out + outPos, in + inPos, numLiterals);
+    inPos += numLiterals;
+    outPos += numLiterals;
+    if (inPos == inLen) {
+      // the last sequence has no match
+      break;
+    }
+    if ((inLen - inPos) < 2) {
+      return false;
+    }
+    uint32_t offset = in[inPos] | (in[inPos + 1] << 8);
+    inPos += 2;
+    uint32_t len = token & 0xF;
+    if (!readLength(in, inPos, inLen, len)) {
+      return false;
+    }
+    len += MIN_MATCH;
+    if (!offset || offset > (outPos + DICT_SIZE) || len > (outLen - outPos)) {
+      return false;
+    }
+    // the part of the match that falls in the dictionary
+    if (offset > outPos) {
+      uint32_t dictPos = DICT_SIZE - (offset - outPos);
+      uint32_t dictLen = offset - outPos;
+      if (dictLen > len) {
+        dictLen = len;
+      }
+      memcpy(out + outPos, dictionary + dictPos, dictLen);
+      outPos += dictLen;
+      len -= dictLen;
+    }
+    // then the rest one byte at a time since the match can overlap itself
+    uint8_t *dst = out + outPos;
+    const uint8_t *src = dst - offset;
+    for (uint32_t i = 0; i < len; ++i) {
+      dst[i] = src[i];
+    }
+    outPos += len;
+  }
+  if (outPos != outLen) {
+    ERROR_LOGF("Decompressed %u bytes, expected %u", outPos, outLen);
+    return false;
+  }
+  return true;
+}
+
+uint32_t Compression::maxInput()
+{
+  return MAX_OFFSET - DICT_SIZE;
+}
@@ -0,0 +1,47 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <inttypes.h>
+
+// A small LZ77 style codec for serialized modes
+//
+// The compressed data is a list of sequences, each sequence is a token
+// byte followed by a run of literal bytes and then a match which copies
+// bytes from earlier in the output:
+//
+//   token          high nibble: literal count, low nibble: match length - 4
+//   literal ext    if the literal count is 15 more bytes follow which are
+//                  added to it, until one of them is not 255
+//   literals       the literal bytes copied straight to the output
+//   offset         2 bytes, how far back from the output the match starts
+//   match ext      same as literal ext but for the match length
+//
+// The last sequence has no match, it ends when the input runs out. The
+// output is preceded by a static dictionary of bytes that are common in
+// serialized modes so matches can reach back into it, this lets even a
+// single mode sent over IR find matches before it has repeated itself.
+class Compression
+{
+  // private unimplemented constructor
+  Compression();
+
+public:
+  // compress inLen bytes into at most outLen bytes, returns the size of
+  // the compressed data or 0 if it didn't fit, the margin is the number
+  // of extra bytes needed past the end of the output to decompress in place
+  static uint32_t compress(const uint8_t *in, uint32_t inLen, uint8_t *out,
+    uint32_t outLen, uint32_t *margin = nullptr);
+
+  // decompress into exactly outLen bytes, returns false if the data
+  // is malformed or doesn't produce outLen bytes. The data can be
+  // decompressed in place by putting it at the end of a buffer of
+  // outLen + margin bytes, the output then never catches up to it
+  static bool decompress(const uint8_t *in, uint32_t inLen, uint8_t *out,
+    uint32_t outLen);
+
+  // the largest amount of data that can be compressed, matches can't
+  // reach back further than the 2 byte offset allows
+  static uint32_t maxInput();
+};
+
+#endif
@@ -1,6 +1,7 @@
 #include "Infrared.h"
 
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
 #include "TimeControl.h"
 #include "BitStream.h"
 #include "Buttons.h"
@@ -88,7 +89,7 @@ bool Infrared::dataReady()
   return (m_irData.bytepos() == (uint32_t)(total + 1));
 }
 
-bool Infrared::read(SerialBuffer &data)
+bool Infrared::read(SerialBufferView &data)
 {
   if (!m_irData.bytepos() || m_irData.bytepos() > MAX_DATA_TRANSFER) {
     // nothing to read, or somehow read way too much
@@ -102,20 +103,20 @@ bool Infrared::read(SerialBuffer &data)
     DEBUG_LOGF("Received bad data size: %u", size);
     return false;
   }
-  // the actual data starts 1 byte later because of the size byte
-  const uint8_t *actualData = m_irData.data() + 1;
-  if (!data.rawInit(actualData, size)) {
-    DEBUG_LOG("Failed to init buffer for IR read");
+  // the view points into the receive buffer so the IR state can't be
+  // reset until whoever reads it calls resetReceiver
+  if (!data.rawInit(m_irData.data() + 1, size)) {
+    DEBUG_LOG("Failed to view IR data");
     return false;
   }
-  for (uint32_t i = 0; i < size; ++i) {
-    DEBUG_LOGF("Read: 0x%x", actualData[i]);
-  }
-  // reset the IR state and receive buffer
-  resetIRState();
   return true;
 }
 
+void Infrared::resetReceiver()
+{
+  resetIRState();
+}
+
 bool Infrared::write(SerialBuffer &data)
 {
   uint32_t size = data.rawSize();
@@ -6,6 +6,7 @@
 #include "BitStream.h"
 
 class SerialBuffer;
+class SerialBufferView;
 
 class Infrared
 {
@@ -21,8 +22,10 @@ public:
   // check whether a full IR message is ready to read
   static bool dataReady();
 
-  // read any received data from internal buffer
-  static bool read(SerialBuffer &data);
+  // point a view at the received data without copying it, the view
+  // is good until resetReceiver is called to receive the next message
+  static bool read(SerialBufferView &data);
+  static void resetReceiver();
   // write data to internal to queue for send
   static bool write(SerialBuffer &data);
 
@@ -10,8 +10,44 @@
 #define POWER_LED_PIN 7
 #define POWER_LED_CLK 8
 
+#ifdef LED_GAMMA_CORRECTION
+// gamma 2.2 lookup table
+static const uint8_t gamma8[256] = {
+    0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+    1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+    3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+    6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+   12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+   20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+   30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+   42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+   56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+   73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+   91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+  113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+  137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+  163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+  192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+  223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+#endif
+
+// produce a single output channel from a linear pattern channel
+static inline uint8_t outputChannel(uint8_t val, uint8_t brightness)
+{
+#ifdef LED_GAMMA_CORRECTION
+  val = gamma8[val];
+#endif
+  return vscale8(val, brightness);
+}
+
 // array of led color values
 RGBColor Leds::m_ledColors[LED_COUNT] = { RGB_OFF };
+// the final colors that are sent out to the leds
+RGBColor Leds::m_ledOutput[LED_COUNT] = { RGB_OFF };
+// start dirty so the first update pushes the initial colors
+bool Leds::m_dirty = true;
+uint32_t Leds::m_skippedFrames = 0;
 // the onboard LED on the adafruit board
 Adafruit_DotStar Leds::m_onboardLED(1, POWER_LED_PIN, POWER_LED_CLK, DOTSTAR_BGR);
 // global brightness
@@ -20,7 +56,7 @@ uint32_t Leds::m_brightness = DEFAULT_BRIGHTNESS;
 bool Leds::init()
 {
   // setup leds on data pin 4
-  FastLED.addLeds<NEOPIXEL, LED_DATA_PIN>((CRGB *)m_ledColors, LED_COUNT);
+  FastLED.addLeds<NEOPIXEL, LED_DATA_PIN>((CRGB *)m_ledOutput, LED_COUNT);
   // get screwed fastled, don't throttle us!
   FastLED.setMaxRefreshRate(0, false);
   // clear the onboard led so it displays nothing
@@ -32,7 +68,10 @@ void Leds::cleanup()
 {
   for (uint32_t i = 0; i < LED_COUNT; ++i) {
     m_ledColors[i].clear();
+    m_ledOutput[i].clear();
   }
+  m_dirty = true;
+  m_skippedFrames = 0;
 }
 
 void Leds::clearOnboardLED()
@@ -42,6 +81,18 @@ void Leds::clearOnboardLED()
   m_onboardLED.show();
 }
 
+void Leds::setBrightness(uint32_t brightness)
+{
+  if (brightness > 255) {
+    brightness = 255;
+  }
+  if (brightness != m_brightness) {
+    m_brightness = brightness;
+    // every output color changes with the brightness
+    m_dirty = true;
+  }
+}
+
 void Leds::setIndex(LedPos target, RGBColor col)
 {
   // safety
@@ -51,7 +102,21 @@ void Leds::setIndex(LedPos target, RGBColor col)
   // FLIP THE INDEXES because we want our enums to go from 
   // PINKIE to INDEX for sake of simple iteration in menus
   // but the current hardware configuration is flipped
-  m_ledColors[LED_LAST - target] = col;
+  RGBColor &led = m_ledColors[LED_LAST - target];
+  if (led != col) {
+    led = col;
+    m_dirty = true;
+  }
+}
+
+RGBColor Leds::getIndex(LedPos target)
+{
+  // safety
+  if (target > LED_LAST) {
+    target = LED_LAST;
+  }
+  // the indexes are flipped, see setIndex
+  return m_ledColors[LED_LAST - target];
 }
 
 void Leds::setRange(LedPos first, LedPos last, RGBColor col)
@@ -115,5 +180,23 @@ void Leds::blinkFingers(Finger first, Finger last, uint32_t offMs, uint32_t onMs
 
 void Leds::update()
 {
+  // the leds hold their last color so there is no need to push
+  // the exact same frame out again, this is the majority of ticks
+  // for solid patterns and the long off phases of dops
+  if (!m_dirty) {
+    m_skippedFrames++;
+    return;
+  }
+  // run the linear pattern colors through brightness, gamma and
+  // color order in a single pass into the buffer fastled sends out
+  uint8_t brightness = (uint8_t)m_brightness;
+  for (uint32_t i = 0; i < LED_COUNT; ++i) {
+    const RGBColor &col = m_ledColors[i];
+    RGBColor &out = m_ledOutput[i];
+    out.raw[0] = outputChannel(col.raw[LED_ORDER_0], brightness);
+    out.raw[1] = outputChannel(col.raw[LED_ORDER_1], brightness);
+    out.raw[2] = outputChannel(col.raw[LED_ORDER_2], brightness);
+  }
   FastLED.show();
+  m_dirty = false;
 }
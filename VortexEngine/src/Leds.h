@@ -12,6 +12,21 @@
 // the starting default brightness
 #define DEFAULT_BRIGHTNESS 255
 
+// Gamma Correction
+//
+// Uncomment this to gamma correct the colors on their way out to the
+// leds, patterns still work with plain linear colors either way
+//#define LED_GAMMA_CORRECTION
+
+// Color Order
+//
+// Which channel of the pattern color feeds each channel of the output,
+// the NEOPIXEL driver already sends in GRB order so the default is a
+// straight copy, swap these around for strips wired in another order
+#define LED_ORDER_0 0   // red
+#define LED_ORDER_1 1   // green
+#define LED_ORDER_2 2   // blue
+
 class Leds
 {
   // private unimplemented constructor
@@ -33,6 +48,9 @@ public:
   static void clearRange(LedPos first, LedPos last) { setRange(first, last, HSV_OFF); }
   static void clearAll() { setAll(HSV_OFF); }
 
+  // get the current color of an individual LED
+  static RGBColor getIndex(LedPos target);
+
   // control two LEDs on a finger, these are appropriate for use in internal pattern logic
   static void setFinger(Finger finger, RGBColor col);
   static void setFingers(Finger first, Finger last, RGBColor col);
@@ -60,11 +78,16 @@ public:
 
   // global brightness
   static uint32_t getBrightness() { return m_brightness; }
-  static void setBrightness(uint32_t brightness) { m_brightness = brightness; }
+  static void setBrightness(uint32_t brightness);
 
-  // actually update the LEDs and show the changes
+  // actually update the LEDs and show the changes, if nothing
+  // changed since the last update then the show is skipped, this
+  // is also where brightness, gamma and color order are applied
   static void update();
 
+  // the number of updates that were skipped because nothing changed
+  static uint32_t skippedFrames() { return m_skippedFrames; }
+
 private:
   static void clearOnboardLED();
 
@@ -73,6 +96,13 @@ private:
 
   // array of led color values
   static RGBColor m_ledColors[LED_COUNT];
+  // the final colors that are sent out to the leds
+  static RGBColor m_ledOutput[LED_COUNT];
+
+  // whether m_ledColors changed since the last show
+  static bool m_dirty;
+  // the number of shows that were skipped
+  static uint32_t m_skippedFrames;
 
   // the onboard LED on the adafruit board
   static Adafruit_DotStar m_onboardLED;
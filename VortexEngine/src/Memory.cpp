@@ -10,6 +10,9 @@
 
 static uint32_t cur_mem_usage = 0;
 static uint32_t background_usage = 0;
+static uint32_t num_allocations = 0;
+static uint32_t num_blocks = 0;
+static uint32_t max_mem_usage = 0;
 
 #define MAX_MEMORY 50000
 
@@ -33,6 +36,11 @@ void *_vmalloc(uint32_t size)
   b->size = size;
   cur_mem_usage += b->size;
   background_usage += sizeof(memory_block);
+  num_allocations++;
+  num_blocks++;
+  if (cur_mem_usage > max_mem_usage) {
+    max_mem_usage = cur_mem_usage;
+  }
   //DEBUG_LOGF("malloc(): %u (%u) (%u)", b->size, cur_memory_usage, background_usage);
   return b->p;
 }
@@ -51,6 +59,11 @@ void *_vcalloc(uint32_t size, uint32_t amount)
   b->size = real_amount;
   cur_mem_usage += b->size;
   background_usage += sizeof(memory_block);
+  num_allocations++;
+  num_blocks++;
+  if (cur_mem_usage > max_mem_usage) {
+    max_mem_usage = cur_mem_usage;
+  }
   //DEBUG_LOGF("calloc(): %u (%u) (%u)", b->size, cur_mem_usage, background_usage);
   return b->p;
 }
@@ -84,8 +97,13 @@ void *_vrealloc(void *ptr, uint32_t size)
   b->size = size;
   cur_mem_usage -= old_size;
   cur_mem_usage += b->size;
+  num_allocations++;
   if (!old_size) {
     background_usage += sizeof(memory_block);
+    num_blocks++;
+  }
+  if (cur_mem_usage > max_mem_usage) {
+    max_mem_usage = cur_mem_usage;
   }
   return b->p;
 }
@@ -98,6 +116,7 @@ void _vfree(void *ptr)
   memory_block *base = get_base(ptr);
   cur_mem_usage -= base->size;
   background_usage -= sizeof(memory_block);
+  num_blocks--;
   //DEBUG_LOGF("free(): %u (%u) (%u)", base->size, cur_mem_usage, background_usage);
   free(base);
 }
@@ -117,6 +136,26 @@ uint32_t cur_memory_usage_total()
   return cur_mem_usage + background_usage;
 }
 
+uint32_t cur_memory_blocks()
+{
+  return num_blocks;
+}
+
+uint32_t total_memory_allocations()
+{
+  return num_allocations;
+}
+
+uint32_t max_memory_usage()
+{
+  return max_mem_usage;
+}
+
+void reset_max_memory_usage()
+{
+  max_mem_usage = cur_mem_usage;
+}
+
 void *operator new(size_t size)
 {
   return _vmalloc(size);
@@ -38,6 +38,13 @@ uint32_t cur_memory_usage();
 uint32_t cur_memory_usage_background();
 // memory used by everything
 uint32_t cur_memory_usage_total();
+// the number of blocks currently allocated
+uint32_t cur_memory_blocks();
+// the number of allocations (including reallocs) ever made
+uint32_t total_memory_allocations();
+// the highest memory used by regular code since the last reset
+uint32_t max_memory_usage();
+void reset_max_memory_usage();
 
 void *operator new(size_t size);
 void operator delete(void *ptr) noexcept;
@@ -5,14 +5,21 @@
 #include "patterns/Pattern.h"
 #include "PatternBuilder.h"
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
 #include "TimeControl.h"
 #include "Colorset.h"
+#include "Leds.h"
 #include "Log.h"
 
 #include <Arduino.h>
 
+// each entry in the table of records that version 1 had up front is a
+// wire id and a 2 byte length
+#define RECORD_ENTRY_SIZE 3
+
 Mode::Mode() :
-  m_ledEntries()
+  m_ledEntries(),
+  m_batchPlay(false)
 {
 }
 
@@ -32,10 +39,20 @@ void Mode::init()
     }
     entry->init();
   }
+  // every pattern starts from this tick so if they are all the same
+  // they will stay identical for as long as the mode plays
+  m_batchPlay = canBatchPlay();
 }
 
 void Mode::play()
 {
+  if (m_batchPlay) {
+    // the rest of the leds would produce the exact same color as the first
+    // so instead of running each of their patterns just mirror the first
+    m_ledEntries[LED_FIRST]->play();
+    Leds::setRange((LedPos)(LED_FIRST + 1), LED_LAST, Leds::getIndex(LED_FIRST));
+    return;
+  }
   for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
     // grab the entry for this led
     Pattern *entry = m_ledEntries[pos];
@@ -52,46 +69,190 @@ void Mode::play()
   }
 }
 
+void Mode::seek(uint32_t targetTick)
+{
+  m_batchPlay = canBatchPlay();
+  for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
+    Pattern *entry = m_ledEntries[pos];
+    if (!entry) {
+      continue;
+    }
+    // each pattern seeks by itself because patterns that repeat can each
+    // skip ahead by a different amount
+    entry->seek(targetTick);
+    if (m_batchPlay) {
+      // only the first pattern is played, see play()
+      Leds::setRange((LedPos)(LED_FIRST + 1), LED_LAST, Leds::getIndex(LED_FIRST));
+      break;
+    }
+  }
+}
+
 void Mode::serialize(SerialBuffer &buffer) const
 {
   //DEBUG_LOG("Serialize");
-  //   4 mode flags (*)       flags defined whether multi pattern or not
-  //     led1..N {            if multi pattern then 10x led, otherwise 1x
-  //      colorset1..N {
-  //       1 numColors (0 - 255)
-  //       rgb1..N {
+  //   1 version (MODE_VERSION_BIT | MODE_VERSION)
+  //   1 mode flags (*)       flags defined whether multi pattern or not
+  //   1 num records          if multi or all same pattern then 1, otherwise 10x led
+  //     record1..N {
+  //      1 pattern wire id   the id of the pattern, 0xFF if the led is empty
+  //      varint length       the number of bytes of pattern data shifted up
+  //                          by one, the low bit is set if the pattern has
+  //                          the default params and only the colorset is saved
+  //      colorset {
+  //       1 numColors (0 - 8) and the encoding in the high bits
+  //       1 mask of colors in the shared palette if the encoding is indexed
+  //       color1..N {
+  //        1 index into the shared palette
+  //        or
   //        1 red (0-255)
   //        1 grn (0-255)
   //        1 blu (0-255)
   //       }
   //      }
-  //      1 pattern id (0 - 255)
+  //      ...                 any params of the pattern
+  //     }
   //
-  uint32_t flags = 0;
+  // Because each record has a length a pattern can be skipped without
+  // parsing it and a pattern that gains or loses params between versions
+  // only reads the params it knows about
+  uint8_t flags = 0;
   if (isMultiLed()) {
     flags |= MODE_FLAG_MULTI_LED;
   } else if (isSameSingleLed()) {
     flags |= MODE_FLAG_ALL_SAME_SINGLE;
   }
+  uint8_t numRecords = LED_COUNT;
+  if (flags & (MODE_FLAG_MULTI_LED | MODE_FLAG_ALL_SAME_SINGLE)) {
+    numRecords = 1;
+  }
   //DEBUG_LOGF("Saved mode flags: %x (%u %u)", flags, buffer.size(), buffer.capacity());
+  buffer.serialize((uint8_t)(MODE_VERSION_BIT | MODE_VERSION));
   buffer.serialize(flags);
-  for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
+  buffer.serialize(numRecords);
+  for (LedPos pos = LED_FIRST; pos < numRecords; ++pos) {
     const Pattern *entry = m_ledEntries[pos];
     if (!entry) {
+      // this led is empty
+      buffer.serialize(PatternBuilder::toWireID(PATTERN_NONE));
+      buffer.serializeVarint(0);
       continue;
     }
-    // just serialize the pattern then colorset
-    entry->serialize(buffer);
-    // if either of these flags are present only serialize the first pattern
-    if (flags & (MODE_FLAG_MULTI_LED | MODE_FLAG_ALL_SAME_SINGLE)) {
-      break;
+    SerialBuffer record;
+    entry->serialize(record);
+    // the params are everything the pattern wrote after its colorset
+    uint32_t colorsetSize = entry->getColorset()->serializedSize();
+    buffer.serialize(PatternBuilder::toWireID(entry->getPatternID()));
+    if (record.size() >= colorsetSize &&
+        entry->hasDefaultParams(record.data() + colorsetSize, record.size() - colorsetSize)) {
+      // only the colorset
+      buffer.serializeVarint((colorsetSize << 1) | 1);
+      entry->Pattern::serialize(buffer);
+      continue;
     }
+    buffer.serializeVarint(record.size() << 1);
+    buffer += record;
   }
 }
 
-void Mode::unserialize(SerialBuffer &buffer)
+void Mode::unserialize(SerialBufferView &buffer)
 {
   clearPatterns();
+  m_batchPlay = false;
+  uint8_t version = buffer.peek8();
+  if (!(version & MODE_VERSION_BIT)) {
+    unserializeLegacy(buffer);
+    return;
+  }
+  version &= ~MODE_VERSION_BIT;
+  if (version > MODE_VERSION) {
+    // newer firmware, try to read it as the current version anyway
+    DEBUG_LOGF("Mode version %u is newer than %u", version, MODE_VERSION);
+  }
+  buffer.skip(1);
+  uint8_t flags = buffer.unserialize8();
+  uint8_t numRecords = buffer.unserialize8();
+  if (numRecords > LED_COUNT) {
+    ERROR_LOGF("Mode has too many records: %u", numRecords);
+    return;
+  }
+  // version 1 had a table of every wire id and 2 byte length up front
+  SerialBufferView table(buffer.frontUnserializer(), buffer.remaining());
+  if (version == 1 && !buffer.skip(numRecords * RECORD_ENTRY_SIZE)) {
+    ERROR_LOG("Mode record table is truncated");
+    return;
+  }
+  for (LedPos pos = LED_FIRST; pos < numRecords; ++pos) {
+    uint8_t wireID = 0;
+    uint32_t length = 0;
+    bool defaultParams = false;
+    if (version == 1) {
+      wireID = table.unserialize8();
+      length = table.unserialize16();
+    } else {
+      wireID = buffer.unserialize8();
+      length = buffer.unserializeVarint();
+      defaultParams = (length & 1) != 0;
+      length >>= 1;
+    }
+    // each pattern only sees the data of its own record so it can't read
+    // into the next one, any params missing from an older record are left
+    // at their defaults and any extra params from a newer one are skipped
+    SerialBufferView record(buffer.frontUnserializer(), length);
+    if (!buffer.skip(length)) {
+      ERROR_LOG("Mode record is truncated");
+      return;
+    }
+    if (!unserializeRecord(pos, wireID, defaultParams, record, flags)) {
+      return;
+    }
+  }
+  if (m_ledEntries[LED_FIRST] && (flags & MODE_FLAG_ALL_SAME_SINGLE)) {
+    bindSameSingle();
+  }
+}
+
+bool Mode::unserializeRecord(LedPos pos, uint8_t wireID, bool defaultParams,
+  SerialBufferView &record, uint8_t &flags)
+{
+  if (wireID == PatternBuilder::toWireID(PATTERN_NONE)) {
+    // this led is empty
+    return true;
+  }
+  Pattern *pat = PatternBuilder::make(PatternBuilder::fromWireID(wireID));
+  if (!pat) {
+    // a pattern this firmware doesn't have, every record starts with a
+    // colorset so keep the colors on the first single led pattern that
+    // is built into this firmware instead
+    DEBUG_LOGF("Unknown pattern %u, replacing it", wireID);
+    for (PatternID id = PATTERN_SINGLE_FIRST; !pat && id <= PATTERN_SINGLE_LAST; ++id) {
+      pat = PatternBuilder::make(id);
+    }
+    if (!pat) {
+      return false;
+    }
+    defaultParams = true;
+    if (flags & MODE_FLAG_MULTI_LED) {
+      // a multi led pattern was replaced with a single led one
+      flags = MODE_FLAG_ALL_SAME_SINGLE;
+    }
+  }
+  if (defaultParams) {
+    // the pattern already has the default params, but multi led patterns
+    // only build their sub patterns from the colorset in init
+    pat->Pattern::unserialize(record);
+    pat->setLedPos(pos);
+    pat->init();
+  } else {
+    pat->unserialize(record);
+    pat->setLedPos(pos);
+  }
+  m_ledEntries[pos] = pat;
+  return true;
+}
+
+void Mode::unserializeLegacy(SerialBufferView &buffer)
+{
   uint32_t flags = 0;
   buffer.unserialize(&flags);
   // unserialize the first pattern
@@ -100,27 +261,40 @@ void Mode::unserialize(SerialBuffer &buffer)
     // done
     return;
   }
-  PatternID firstID = m_ledEntries[0]->getPatternID();
-  const Colorset *firstSet = m_ledEntries[0]->getColorset();
+  if (flags & MODE_FLAG_ALL_SAME_SINGLE) {
+    bindSameSingle();
+    return;
+  }
   // loop from 2nd led position to last, skipping first
   for (LedPos pos = (LedPos)(LED_FIRST + 1); pos < LED_COUNT; ++pos) {
-    if (flags & MODE_FLAG_ALL_SAME_SINGLE) {
-      m_ledEntries[pos] = PatternBuilder::make(firstID);
-      if (!m_ledEntries[pos]) {
-        ERROR_LOG("Failed to created pattern");
-        return;
-      }
-      m_ledEntries[pos]->bind(firstSet, pos);
-    } else {
-      m_ledEntries[pos] = PatternBuilder::unserialize(buffer);
-      if (!m_ledEntries[pos]) {
-        ERROR_LOG("Failed to unserialize pattern from buffer");
-        return;
-      }
+    m_ledEntries[pos] = PatternBuilder::unserialize(buffer);
+    if (!m_ledEntries[pos]) {
+      ERROR_LOG("Failed to unserialize pattern from buffer");
+      return;
     }
+    m_ledEntries[pos]->setLedPos(pos);
   }
 }
 
+bool Mode::bindSameSingle()
+{
+  PatternID firstID = m_ledEntries[LED_FIRST]->getPatternID();
+  const Colorset *firstSet = m_ledEntries[LED_FIRST]->getColorset();
+  for (LedPos pos = (LedPos)(LED_FIRST + 1); pos < LED_COUNT; ++pos) {
+    // a bad record count may have already filled this led
+    if (m_ledEntries[pos]) {
+      delete m_ledEntries[pos];
+    }
+    m_ledEntries[pos] = PatternBuilder::make(firstID);
+    if (!m_ledEntries[pos]) {
+      ERROR_LOG("Failed to created pattern");
+      return false;
+    }
+    m_ledEntries[pos]->bind(firstSet, pos);
+  }
+  return true;
+}
+
 bool Mode::bind(PatternID id, const Colorset *set)
 {
   if (isMultiLedPatternID(id)) {
@@ -148,6 +322,7 @@ bool Mode::bindSingle(PatternID id, const Colorset *set, LedPos pos)
   pat->bind(set, pos);
   delete m_ledEntries[pos];
   m_ledEntries[pos] = pat;
+  m_batchPlay = false;
   return true;
 }
 
@@ -161,6 +336,7 @@ bool Mode::bindMulti(PatternID id, const Colorset *set)
   pat->bind(set);
   unbindAll();
   m_multiPat = pat;
+  m_batchPlay = false;
   return true;
 }
 
@@ -173,6 +349,7 @@ void Mode::unbindSingle(LedPos pos)
     delete m_ledEntries[pos];
     m_ledEntries[pos] = nullptr;
   }
+  m_batchPlay = false;
 }
 
 void Mode::unbindMulti()
@@ -181,6 +358,7 @@ void Mode::unbindMulti()
     delete m_multiPat;
     m_multiPat = nullptr;
   }
+  m_batchPlay = false;
 }
 
 void Mode::unbindAll()
@@ -301,9 +479,14 @@ bool Mode::isSameSingleLed() const
   if (isMultiLed()) {
     return false;
   }
+  const Pattern *first = m_ledEntries[0];
   for (uint32_t i = LED_FIRST + 1; i < LED_COUNT; ++i) {
-    // if any don't match 0 then no good
-    if (!m_ledEntries[i] || !m_ledEntries[i]->equals(m_ledEntries[0])) {
+    // if any don't match 0 then no good, the patterns of a mode that
+    // were bound together all share one palette so equals returns right
+    // away for those and only compares the colors of the others
+    const Pattern *entry = m_ledEntries[i];
+    if (!entry || entry->getPatternID() != first->getPatternID() ||
+        !entry->getColorset()->equals(first->getColorset())) {
       return false;
     }
   }
@@ -311,6 +494,15 @@ bool Mode::isSameSingleLed() const
   return true;
 }
 
+bool Mode::canBatchPlay() const
+{
+  // the patterns only stay in lockstep if every led sees the same time
+  if (Time::getTickOffset(LED_LAST) != 0) {
+    return false;
+  }
+  return isSameSingleLed();
+}
+
 void Mode::clearPatterns()
 {
   for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
@@ -325,6 +517,7 @@ void Mode::clearPattern(LedPos pos)
   }
   delete m_ledEntries[pos];
   m_ledEntries[pos] = nullptr;
+  m_batchPlay = false;
 }
 
 void Mode::clearColorsets()
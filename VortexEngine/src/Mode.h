@@ -11,6 +11,7 @@ using namespace std;
 class MultiLedPattern;
 class SingleLedPattern;
 class SerialBuffer;
+class SerialBufferView;
 class Pattern;
 class Colorset;
 
@@ -21,6 +22,14 @@ class Colorset;
 // the mode is utilizing the same single-led pattern on each finger
 #define MODE_FLAG_ALL_SAME_SINGLE   (1 << 1)
 
+// every serialized mode starts with a version byte, older firmware
+// started each mode with 4 bytes of flags that only ever used the low
+// bits so the high bit is enough to tell the two apart
+#define MODE_VERSION_BIT            0x80
+// the current version of the mode format, bump this whenever the format
+// changes and teach Mode::unserialize how to read the older version
+#define MODE_VERSION                2
+
 // the keyword 'ALL_SLOTS' can be used to refer to all of the
 // mode slots at once when using changePattern or changeColorset
 #define ALL_SLOTS LED_COUNT
@@ -37,10 +46,15 @@ public:
   // Play the mode
   void play();
 
+  // initialize the mode and bring it to the given tick of its timeline
+  // as if init() had been called that many ticks ago, this is used to
+  // sync up with another glove that is already playing the mode
+  void seek(uint32_t targetTick);
+
   // save the mode to serial
   void serialize(SerialBuffer &buffer) const;
-  // load the mode from serial
-  void unserialize(SerialBuffer &buffer);
+  // load the mode from serial, this reads every version of the format
+  void unserialize(SerialBufferView &buffer);
 
   // bind either a multi-led pattern o
   bool bind(PatternID id, const Colorset *set);
@@ -78,6 +92,17 @@ private:
   bool setSinglePat(PatternID pat, LedPos pos);
   bool setMultiPat(PatternID pat);
 
+  // whether play() can run only the first pattern and mirror it
+  bool canBatchPlay() const;
+
+  // load the format of older firmware which has no version or records
+  void unserializeLegacy(SerialBufferView &buffer);
+  // build the pattern for one record of the serialized mode
+  bool unserializeRecord(LedPos pos, uint8_t wireID, bool defaultParams,
+    SerialBufferView &record, uint8_t &flags);
+  // fill the rest of the leds with copies of the first pattern
+  bool bindSameSingle();
+
   // erase any stored patterns or colorsets
   void clearPatterns();
   void clearPattern(LedPos pos);
@@ -105,6 +130,11 @@ private:
     // or the first one is also a multi led pat
     MultiLedPattern *m_multiPat;
   };
+
+  // all of the leds run the same single led pattern in lockstep so only the
+  // first pattern is played, this is decided in init() and cleared by any
+  // change to the patterns until the mode is initialized again
+  bool m_batchPlay;
 };
 
 #endif
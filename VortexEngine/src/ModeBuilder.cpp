@@ -5,6 +5,7 @@
 #include "patterns/Pattern.h"
 #include "PatternBuilder.h"
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
 #include "Colorset.h"
 #include "Mode.h"
 #include "Log.h"
@@ -41,7 +42,7 @@ Mode *ModeBuilder::make(PatternID id, RGBColor c1, RGBColor c2, RGBColor c3,
   return make(id, &set);
 }
 
-Mode *ModeBuilder::unserialize(SerialBuffer &buffer)
+Mode *ModeBuilder::unserialize(SerialBufferView &buffer)
 {
   // create the new mode object
   Mode *newMode = new Mode();
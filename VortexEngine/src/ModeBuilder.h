@@ -5,6 +5,7 @@
 #include "Patterns.h"
 
 class SerialBuffer;
+class SerialBufferView;
 class Colorset;
 class Pattern;
 class Mode;
@@ -23,7 +24,7 @@ public:
     RGBColor c6 = RGB_OFF, RGBColor c7 = RGB_OFF, RGBColor c8 = RGB_OFF);
 
   // unserialize a buffer into a mode
-  static Mode *unserialize(SerialBuffer &buffer);
+  static Mode *unserialize(SerialBufferView &buffer);
 
 private:
 };
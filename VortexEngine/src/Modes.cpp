@@ -2,6 +2,8 @@
 
 #include "patterns/Pattern.h"
 
+#include "PatternBuilder.h"
+#include "PatternPool.h"
 #include "SerialBuffer.h"
 #include "TimeControl.h"
 #include "ModeBuilder.h"
@@ -9,13 +11,26 @@
 #include "Storage.h"
 #include "Buttons.h"
 #include "Mode.h"
+#include "Memory.h"
 #include "Leds.h"
 #include "Log.h"
 
+// the storage key of the record that holds the number of modes, each mode
+// is stored in a record of its own under the keys that follow it
+#define MODES_STORAGE_KEY 0
+#define MODE_STORAGE_KEY(index) ((index) + 1)
+
+#if (NUM_MODES + 1) > STORAGE_MAX_KEYS
+#error "Not enough storage keys for every mode"
+#endif
+
 // static members
 uint8_t Modes::m_curMode = 0;
 uint8_t Modes::m_numModes = 0;
 Mode *Modes::m_pCurMode = nullptr;
+Mode *Modes::m_modeCache[MODE_CACHE_SIZE] = { nullptr };
+uint8_t Modes::m_cacheIndexes[MODE_CACHE_SIZE] = { 0 };
+bool Modes::m_prewarmPending = false;
 SerialBuffer Modes::m_serializedModes[NUM_MODES];
 
 bool Modes::init()
@@ -44,6 +59,11 @@ void Modes::play()
     DEBUG_LOG("Error failed to load any modes!");
     return;
   }
+  // build the next mode on the tick after a switch, never on the same
+  // tick as the switch so the two costs don't land on a single tick
+  if (m_prewarmPending) {
+    prewarmNextMode();
+  }
   // shortclick cycles to the next mode
   if (g_pButton->onShortClick()) {
     nextMode();
@@ -66,60 +86,107 @@ bool Modes::loadStorage()
   // this is good on memory, but it erases what they have stored
   // before we know whether there is something actually saved
   clearModes();
-  SerialBuffer modesBuffer;
-  // only read storage if the modebuffer isn't filled
-  if (!Storage::read(modesBuffer) || !modesBuffer.size()) {
-    DEBUG_LOG("Empty buffer read from storage");
-    // this kinda sucks whatever they had loaded is gone
+  SerialBuffer headerBuffer;
+  if (!Storage::read(MODES_STORAGE_KEY, headerBuffer)) {
+    // older firmware saved all the modes in a single buffer
+    SerialBuffer modesBuffer;
+    if (!Storage::readLegacy(modesBuffer) || !modesBuffer.size()) {
+      DEBUG_LOG("Empty buffer read from storage");
+      // this kinda sucks whatever they had loaded is gone
+      return false;
+    }
+    SerialBufferView modesView(modesBuffer);
+    if (!unserialize(modesView)) {
+      return false;
+    }
+    // move them over to the new storage right away
+    return saveStorage();
+  }
+  headerBuffer.resetUnserializer();
+  uint8_t numModes = headerBuffer.unserialize8();
+  // older firmware didn't save the version of the modes
+  uint8_t version = headerBuffer.unserialize8();
+  if (!numModes) {
+    DEBUG_LOG("Did not find any modes");
     return false;
   }
-  return unserialize(modesBuffer);
+  // only check the modes are there, each one is read from storage
+  // the first time it's played so nothing else needs to be loaded now
+  for (uint8_t i = 0; i < numModes; ++i) {
+    if (!Storage::exists(MODE_STORAGE_KEY(i))) {
+      DEBUG_LOGF("Mode %u is missing from storage", i);
+      return false;
+    }
+  }
+  m_numModes = numModes;
+  DEBUG_LOGF("Found %u modes in storage", numModes);
+  if (version < MODE_VERSION) {
+    return migrateStorage(version);
+  }
+  return true;
+}
+
+// bring all of the modes in storage up to the current version of the
+// format, this only runs on the first boot after the format changes
+bool Modes::migrateStorage(uint8_t version)
+{
+  DEBUG_LOGF("Migrating modes from version %u to %u", version, MODE_VERSION);
+  for (uint8_t i = 0; i < m_numModes; ++i) {
+    // the mode reads the old format and writes out the current one
+    Mode *mode = instantiateMode(i);
+    if (!mode) {
+      ERROR_LOGF("Failed to migrate mode %u", i);
+      return false;
+    }
+    m_serializedModes[i].clear();
+    mode->serialize(m_serializedModes[i]);
+    delete mode;
+  }
+  return saveStorage();
 }
 
-// NOTE: Flash storage is limited to about 10,000 writes so
-//       use this function sparingly!
+// NOTE: Flash storage is limited to about 10,000 erases per row, each
+//       mode is its own storage record and only the modes that changed
+//       are written so most saves don't erase anything
 bool Modes::saveStorage()
 {
-  // legacy data format:
-  //  4 num
-  //  4 pattern num
-  //  4 num colors
-  //   4 hue
-  //   4 sat
-  //   4 val
+  // each mode is stored in the format written by Mode::serialize
   //
-  // new data format:
+  // and the header record just holds:
   //  1 num modes (1-255)
-  //   4 mode flags (*)
-  //   1 num leds (1 - 10)
-  //     led1..N [
-  //      1 led (0 - 9)
-  //      1 pattern id (0 - 255)
-  //      colorset1..N [
-  //       1 numColors (0 - 255)
-  //       hsv1..N [
-  //        1 hue (0-255)
-  //        1 sat (0-255)
-  //        1 val (0-255)
-  //       ]
-  //      ]
+  //  1 version of the mode format (MODE_VERSION)
 
   DEBUG_LOG("Saving modes...");
 
   // make sure the current mode is saved to the serial mode storage
   saveCurMode();
 
-  // now serialize the modes into the mode buffer
-  SerialBuffer modesBuffer;
-  serialize(modesBuffer);
-
-  // write the serial buffer to flash storage
-  if (!Storage::write(modesBuffer)) {
+  for (uint8_t i = 0; i < m_numModes; ++i) {
+    if (!m_serializedModes[i].size()) {
+      // this mode hasn't changed since it was read from storage
+      continue;
+    }
+    if (!Storage::write(MODE_STORAGE_KEY(i), m_serializedModes[i])) {
+      DEBUG_LOGF("Failed to write mode %u to storage", i);
+      return false;
+    }
+    // the mode can be read back from storage when it's needed again
+    m_serializedModes[i].clear();
+  }
+  // drop any modes that were deleted since the last save
+  for (uint8_t i = m_numModes; i < NUM_MODES; ++i) {
+    Storage::remove(MODE_STORAGE_KEY(i));
+  }
+  // the header goes last so the modes it counts are all there
+  SerialBuffer headerBuffer;
+  headerBuffer.serialize(m_numModes);
+  headerBuffer.serialize((uint8_t)MODE_VERSION);
+  if (!Storage::write(MODES_STORAGE_KEY, headerBuffer)) {
     DEBUG_LOG("Failed to write storage");
     return false;
   }
 
-  DEBUG_LOGF("Wrote %u bytes to storage", modesBuffer.size());
+  DEBUG_LOGF("Saved %u modes to storage", m_numModes);
 
   return true;
 }
@@ -136,15 +203,20 @@ void Modes::serialize(SerialBuffer &modesBuffer)
       m_pCurMode->serialize(modesBuffer);
       continue;
     }
-    // serialize each after decompressing
-    //m_serializedModes[i].decompress();
-    modesBuffer += m_serializedModes[i];
-    //m_serializedModes[i].compress();
+    if (m_serializedModes[i].size()) {
+      modesBuffer += m_serializedModes[i];
+      continue;
+    }
+    // the modes that haven't changed are only in storage
+    SerialBuffer stored;
+    if (Storage::read(MODE_STORAGE_KEY(i), stored)) {
+      modesBuffer += stored;
+    }
   }
 }
 
 // load the mode from serial
-bool Modes::unserialize(SerialBuffer &modesBuffer)
+bool Modes::unserialize(SerialBufferView &modesBuffer)
 {
   DEBUG_LOG("Loading modes...");
   // this is good on memory, but it erases what they have stored
@@ -186,6 +258,10 @@ bool Modes::setDefaults()
     if ((int)pattern == 0) {
       defaultSet.randomize(8);
     }
+    // skip any patterns that were compiled out
+    if (!PatternBuilder::isAvailable(pattern)) {
+      continue;
+    }
     // add another mode with the given pattern and colorset
     if (!addMode(pattern, &defaultSet)) {
       ERROR_LOG("Failed to add mode");
@@ -197,7 +273,7 @@ bool Modes::setDefaults()
   return true;
 }
 
-bool Modes::addSerializedMode(SerialBuffer &serializedMode)
+bool Modes::addSerializedMode(SerialBufferView &serializedMode)
 {
   Mode *mode = ModeBuilder::unserialize(serializedMode);
   if (!mode) {
@@ -306,8 +382,8 @@ Mode *Modes::nextMode()
   DEBUG_LOGF("Iterated to Next Mode: %u / %u", m_curMode, m_numModes - 1);
   // clear the LEDs when switching modes
   Leds::clearAll();
-  // delete the current mode
-  delete m_pCurMode;
+  // the current mode stays in the cache, it's only deleted if it
+  // falls out of the cache or the cache goes over the memory budget
   m_pCurMode = nullptr;
   if (!initCurMode()) {
     return nullptr;
@@ -318,10 +394,9 @@ Mode *Modes::nextMode()
 
 void Modes::clearModes()
 {
-  if (m_pCurMode) {
-    delete m_pCurMode;
-    m_pCurMode = nullptr;
-  }
+  // the current mode is always in the cache
+  cacheClear();
+  m_pCurMode = nullptr;
   for (uint32_t i = 0; i < m_numModes; ++i) {
     m_serializedModes[i].clear();
   }
@@ -333,19 +408,144 @@ bool Modes::initCurMode()
   if (m_pCurMode) {
     return true;
   }
-  //m_serializedModes[m_curMode].decompress();
-  // make sure the unserializer is reset before trying to unserialize it
-  m_serializedModes[m_curMode].resetUnserializer();
-  DEBUG_LOGF("Current Mode size: %u", m_serializedModes[m_curMode].size());
-  m_pCurMode = ModeBuilder::unserialize(m_serializedModes[m_curMode]);
-  //m_serializedModes[m_curMode].compress();
+  // try to pick up an instance that was already built
+  m_pCurMode = cacheLookup(m_curMode);
   if (!m_pCurMode) {
-    return false;
+    m_pCurMode = instantiateMode(m_curMode);
+    if (!m_pCurMode) {
+      return false;
+    }
+    cacheInsert(0, m_curMode, m_pCurMode);
   }
+  // start the mode over from the beginning
   m_pCurMode->init();
+  // make room if the cache is using too much memory
+  cacheTrim();
+  // the next mode can be built ahead of time on the next tick
+  m_prewarmPending = true;
   return true;
 }
 
+Mode *Modes::instantiateMode(uint8_t index)
+{
+  if (index >= m_numModes) {
+    return nullptr;
+  }
+  // modes that changed since the last save are in memory, the rest are
+  // unserialized straight out of the flash unless they're compressed,
+  // then they're only held in memory until they're built
+  SerialBuffer stored;
+  SerialBufferView serialized(m_serializedModes[index]);
+  if (!serialized.size()) {
+    if (!Storage::view(MODE_STORAGE_KEY(index), serialized)) {
+      ERROR_LOGF("Failed to read mode %u from storage", index);
+      return nullptr;
+    }
+    if (serialized.is_compressed()) {
+      if (!stored.decompress(serialized)) {
+        ERROR_LOGF("Failed to decompress mode %u", index);
+        return nullptr;
+      }
+      serialized = SerialBufferView(stored);
+    }
+  }
+  DEBUG_LOGF("Mode %u size: %u", index, serialized.size());
+  Mode *mode = ModeBuilder::unserialize(serialized);
+  if (!mode) {
+    return nullptr;
+  }
+  mode->init();
+  return mode;
+}
+
+Mode *Modes::cacheLookup(uint8_t index)
+{
+  for (uint32_t i = 0; i < MODE_CACHE_SIZE; ++i) {
+    Mode *mode = m_modeCache[i];
+    if (!mode || m_cacheIndexes[i] != index) {
+      continue;
+    }
+    // move it to the front as the most recently used
+    for (uint32_t j = i; j > 0; --j) {
+      m_modeCache[j] = m_modeCache[j - 1];
+      m_cacheIndexes[j] = m_cacheIndexes[j - 1];
+    }
+    m_modeCache[0] = mode;
+    m_cacheIndexes[0] = index;
+    return mode;
+  }
+  return nullptr;
+}
+
+void Modes::cacheInsert(uint8_t slot, uint8_t index, Mode *mode)
+{
+  if (slot >= MODE_CACHE_SIZE) {
+    delete mode;
+    return;
+  }
+  // the least recently used mode falls off the end
+  delete m_modeCache[MODE_CACHE_SIZE - 1];
+  for (uint32_t i = MODE_CACHE_SIZE - 1; i > slot; --i) {
+    m_modeCache[i] = m_modeCache[i - 1];
+    m_cacheIndexes[i] = m_cacheIndexes[i - 1];
+  }
+  m_modeCache[slot] = mode;
+  m_cacheIndexes[slot] = index;
+}
+
+void Modes::cacheTrim()
+{
+  // drop the least recently used modes while over budget but
+  // never the first slot because that is the current mode
+  for (uint32_t i = MODE_CACHE_SIZE - 1; i > 0 && cacheOverBudget(); --i) {
+    delete m_modeCache[i];
+    m_modeCache[i] = nullptr;
+  }
+}
+
+void Modes::cacheClear()
+{
+  for (uint32_t i = 0; i < MODE_CACHE_SIZE; ++i) {
+    delete m_modeCache[i];
+    m_modeCache[i] = nullptr;
+  }
+  m_prewarmPending = false;
+}
+
+bool Modes::cacheOverBudget()
+{
+  // patterns live in the pattern pool which the allocation tracker never
+  // sees so the slots in use are counted on top of the heap, without the
+  // tracker the patterns are the only thing that is counted
+  uint32_t usage = PatternPool::used() * PatternPool::slotSize();
+#ifdef DEBUG_ALLOCATIONS
+  usage += cur_memory_usage_total();
+#endif
+  return usage > MODE_CACHE_BUDGET;
+}
+
+void Modes::prewarmNextMode()
+{
+  m_prewarmPending = false;
+  if (MODE_CACHE_SIZE < 2 || m_numModes < 2 || cacheOverBudget()) {
+    return;
+  }
+  uint8_t next = (m_curMode + 1) % m_numModes;
+  for (uint32_t i = 0; i < MODE_CACHE_SIZE; ++i) {
+    if (m_modeCache[i] && m_cacheIndexes[i] == next) {
+      // already built
+      return;
+    }
+  }
+  Mode *mode = instantiateMode(next);
+  if (!mode) {
+    return;
+  }
+  // slot it in right behind the current mode
+  cacheInsert(1, next, mode);
+  cacheTrim();
+}
+
 void Modes::saveCurMode()
 {
   if (!m_pCurMode) {
@@ -2,7 +2,9 @@
 #define SETTINGS_H
 
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
 #include "Patterns.h"
+#include "VortexConfig.h"
 
 #include <inttypes.h>
 
@@ -34,7 +36,7 @@ public:
   // saves all modes to a buffer
   static void serialize(SerialBuffer &buffer);
   // load all modes from a buffer
-  static bool unserialize(SerialBuffer &buffer);
+  static bool unserialize(SerialBufferView &buffer);
 
   // set default settings (must save after)
   static bool setDefaults();
@@ -44,7 +46,7 @@ public:
   static bool addMode(const Mode *mode);
 
   // add a new mode by unserializing from a buffer
-  static bool addSerializedMode(SerialBuffer &serializedMode);
+  static bool addSerializedMode(SerialBufferView &serializedMode);
 
   // update the current mode to match the given mode
   static bool setCurMode(PatternID id, const Colorset *set);
@@ -55,13 +57,32 @@ public:
   // iterate to next mode and return it
   static Mode *nextMode();
 
+  // the number of modes and the index of the current mode
+  static uint8_t numModes() { return m_numModes; }
+  static uint8_t curModeIndex() { return m_curMode; }
+
   // delete all modes in the list
   static void clearModes();
 
 private:
   static bool initCurMode();
+  // rewrite the stored modes in the current format
+  static bool migrateStorage(uint8_t version);
   static void saveCurMode();
 
+  // build a fresh instance of a mode from it's serialized buffer
+  static Mode *instantiateMode(uint8_t index);
+
+  // cache of instantiated modes, slot 0 is the most recently used
+  static Mode *cacheLookup(uint8_t index);
+  static void cacheInsert(uint8_t slot, uint8_t index, Mode *mode);
+  static void cacheTrim();
+  static void cacheClear();
+  static bool cacheOverBudget();
+
+  // build the next mode ahead of time so switching to it is instant
+  static void prewarmNextMode();
+
   // the current mode we're on
   static uint8_t m_curMode;
 
@@ -71,7 +92,15 @@ private:
   // the current instantiated mode
   static Mode *m_pCurMode;
 
-  // list of serialized version of bufers
+  // the instantiated modes and which mode index each one is
+  static Mode *m_modeCache[MODE_CACHE_SIZE];
+  static uint8_t m_cacheIndexes[MODE_CACHE_SIZE];
+  // whether the next mode should be built on the next tick
+  static bool m_prewarmPending;
+
+  // serialized versions of the modes that were added or changed since the
+  // last save, the buffer of any other mode is empty and the mode is read
+  // from storage when it's needed
   static SerialBuffer m_serializedModes[NUM_MODES];
 };
 
@@ -1,8 +1,10 @@
 #include "PatternBuilder.h"
 
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
 #include "TimeControl.h"
 #include "Sequence.h"
+#include "Colorset.h"
 
 #include "patterns/multi/TheaterChasePattern.h"
 #include "patterns/multi/SequencedPattern.h"
@@ -19,48 +21,166 @@
 
 #include "Log.h"
 
+// a factory that builds a pattern with the given constructor arguments,
+// the arguments are the default parameters of the pattern
+template<typename T, int... args>
+Pattern *create()
+{
+  return new T(args...);
+}
+
+// macros to create a PatternMap with a given PatternID and some preset LedMaps
+#define oddTipsPattern(pattern) PatternMap(pattern, MAP_FINGER_ODD_TIPS)
+#define oddTopsPattern(pattern) PatternMap(pattern, MAP_FINGER_ODD_TOPS)
+#define evenTipsPattern(pattern) PatternMap(pattern, MAP_FINGER_EVEN_TIPS)
+#define evenTopsPattern(pattern) PatternMap(pattern, MAP_FINGER_EVEN_TOPS)
+
+Pattern *createTheaterChase()
+{
+  Sequence theaterChaseSequence;
+  PatternMap patMap;
+  // there are 10 steps in the theater chase
+  for (uint32_t i = 0; i < 10; ++i) {
+    if (i < 5) {
+      // the first 5 steps are odd tips/tops alternating each step
+      patMap = (i % 2) ? oddTopsPattern(PATTERN_DOPS) : oddTipsPattern(PATTERN_DOPS);
+    } else {
+      // the end 5 steps are even tips/tops alternating each step
+      patMap = (i % 2) ? evenTopsPattern(PATTERN_DOPS) : evenTipsPattern(PATTERN_DOPS);
+    }
+    // each step is 25ms long
+    theaterChaseSequence.addStep(25, patMap);
+  }
+  return new SequencedPattern(theaterChaseSequence);
+}
+
+Pattern *createChaser()
+{
+  Sequence chaserSequence;
+  // there are 8 steps in the chaser
+  for (uint32_t i = 0; i < 8; ++i) {
+    // each step starts all fingers are dops
+    PatternMap patMap(PATTERN_DOPS);
+    // and one finger that moves back and forth is solid
+    patMap.setPatternAt(PATTERN_SOLID, MAP_FINGER((Finger)((i < 5) ? i : (8 - i))));
+    // the step lasts for 300ms
+    chaserSequence.addStep(300, patMap);
+  }
+  return new SequencedPattern(chaserSequence);
+}
+
+// an entry in the pattern registry
+struct PatternEntry
+{
+  // the pattern id, this is the index of the entry in the registry
+  PatternID id;
+  // the id written in save files and sent over IR, this never changes
+  // even if patterns are added or removed from the middle of the enum
+  uint8_t wireID;
+  // any flags of the pattern
+  uint8_t flags;
+  // builds the pattern with it's default parameters
+  Pattern *(*factory)();
+};
+
+// whether a pattern is built into the firmware, see PATTERNS_DISABLED
+#define PATTERN_ENABLED(id) ((PATTERNS_DISABLED & (1ul << (id))) == 0)
+
+// entries for each pattern, disabled patterns keep their entry but don't
+// reference their factory so the pattern code can be left out of the build
+#define SINGLE(id, wire, factory) { id, wire, PATTERN_FLAGS_NONE, PATTERN_ENABLED(id) ? factory : nullptr }
+#define MULTI(id, wire, factory) { id, wire, PATTERN_FLAG_MULTI, PATTERN_ENABLED(id) ? factory : nullptr }
+
+// NOTE: The timings of patterns are only defined at creation time
+//       which means altering the tickrate will not change how fast
+//       a pattern displays unless you re-create it
+static constexpr PatternEntry patternRegistry[] = {
+  SINGLE(PATTERN_STROBE,            0, (create<BasicPattern, 5, 8>)),
+  SINGLE(PATTERN_SOLID,             1, (create<SolidPattern, 0, 20>)),
+  SINGLE(PATTERN_HYPERSTROBE,       2, (create<BasicPattern, 25, 25>)),
+  SINGLE(PATTERN_DOPS,              3, (create<BasicPattern, 2, 13>)),
+  SINGLE(PATTERN_DOPISH,            4, (create<BasicPattern, 2, 7>)),
+  SINGLE(PATTERN_ULTRADOPS,         5, (create<BasicPattern, 1, 3>)),
+  SINGLE(PATTERN_STROBIE,           6, (create<BasicPattern, 3, 22>)),
+  SINGLE(PATTERN_RIBBON,            7, (create<BasicPattern, 20>)),
+  SINGLE(PATTERN_TRACER,            8, (create<TracerPattern>)),
+  SINGLE(PATTERN_BLINKIE,           9, (create<BasicPattern, 5, 8, 35>)),
+  SINGLE(PATTERN_GHOSTCRUSH,        10, (create<BasicPattern, 1, 0, 50>)),
+  SINGLE(PATTERN_ADVANCED,          11, (create<AdvancedPattern, 5, 5, 10, 2, 2, 1>)),
+  SINGLE(PATTERN_BLEND,             12, (create<BlendPattern>)),
+  SINGLE(PATTERN_RECIPROCAL_BLEND,  13, (create<ReciprocalBlendPattern>)),
+  SINGLE(PATTERN_BRACKETS,          14, (create<BracketsPattern>)),
+  MULTI(PATTERN_RABBIT,             15, (create<RabbitPattern>)),
+  MULTI(PATTERN_HUESHIFT,           16, (create<HueShiftPattern>)),
+  MULTI(PATTERN_THEATER_CHASE,      17, createTheaterChase),
+  MULTI(PATTERN_CHASER,             18, createChaser),
+};
+
+// compile time checks that every pattern has exactly one entry, in order,
+// with a flag matching it's id range, and that no wire ids are repeated
+constexpr bool registryInOrder(uint32_t i = 0)
+{
+  return (i >= PATTERN_COUNT) || ((patternRegistry[i].id == i) &&
+    (((patternRegistry[i].flags & PATTERN_FLAG_MULTI) != 0) == isMultiLedPatternID((PatternID)i)) &&
+    registryInOrder(i + 1));
+}
+constexpr bool wireIDUnique(uint32_t i, uint32_t j)
+{
+  return (j >= PATTERN_COUNT) ||
+    ((patternRegistry[i].wireID != patternRegistry[j].wireID) && wireIDUnique(i, j + 1));
+}
+constexpr bool wireIDsUnique(uint32_t i = 0)
+{
+  return (i >= PATTERN_COUNT) || (wireIDUnique(i, i + 1) && wireIDsUnique(i + 1));
+}
+static_assert(sizeof(patternRegistry) / sizeof(patternRegistry[0]) == PATTERN_COUNT,
+  "Every pattern needs an entry in the pattern registry");
+static_assert(registryInOrder(), "Pattern registry entries must be in PatternID order");
+static_assert(wireIDsUnique(), "Pattern registry wire ids must be unique");
+
+// PATTERNS_DISABLED is a 32 bit mask with a bit for each pattern and the
+// firmware needs at least one pattern left to play
+static_assert(PATTERN_COUNT <= 32, "PATTERNS_DISABLED can't mask more than 32 patterns");
+static_assert((PATTERNS_DISABLED & ((1ull << PATTERN_COUNT) - 1)) != ((1ull << PATTERN_COUNT) - 1),
+  "PATTERNS_DISABLED can't disable every pattern");
+
 Pattern *PatternBuilder::make(PatternID id)
 {
   if (id > PATTERN_LAST) {
     DEBUG_LOGF("Invalid pattern id: %u", id);
     return nullptr;
   }
-  if (isMultiLedPatternID(id)) {
-    return makeMulti(id);
-  }
-  return makeSingle(id);
+  return makeInternal(id);
 }
 
 // generate a single LED pattern (nullptr if patternid is not single LED)
 SingleLedPattern *PatternBuilder::makeSingle(PatternID id)
 {
-  if (!isSingleLedPatternID(id)) {
-    return nullptr;
-  }
-  Pattern *pat = makeInternal(id);
-  if (!pat) {
+  if (id > PATTERN_LAST || (patternRegistry[id].flags & PATTERN_FLAG_MULTI)) {
     return nullptr;
   }
   // don't set any flags on single pattersn
-  return (SingleLedPattern *)pat;
+  return (SingleLedPattern *)makeInternal(id);
 }
 
 // generate a multi LED pattern (nullptr if patternid is not multi LED)
 MultiLedPattern *PatternBuilder::makeMulti(PatternID id)
 {
-  if (!isMultiLedPatternID(id)) {
-    return nullptr;
-  }
-  Pattern *pat = makeInternal(id);
-  if (!pat) {
+  if (id > PATTERN_LAST || !(patternRegistry[id].flags & PATTERN_FLAG_MULTI)) {
     return nullptr;
   }
-  return (MultiLedPattern *)pat;
+  return (MultiLedPattern *)makeInternal(id);
 }
 
-Pattern *PatternBuilder::unserialize(SerialBuffer &buffer)
+void PatternBuilder::serialize(const Pattern *pat, SerialBuffer &buffer)
 {
-  Pattern *pat = make((PatternID)buffer.unserialize8());
+  buffer.serialize(toWireID(pat->getPatternID()));
+  pat->serialize(buffer);
+}
+
+Pattern *PatternBuilder::unserialize(SerialBufferView &buffer)
+{
+  Pattern *pat = make(fromWireID(buffer.unserialize8()));
   if (!pat) {
     return nullptr;
   }
@@ -68,88 +188,97 @@ Pattern *PatternBuilder::unserialize(SerialBuffer &buffer)
   return pat;
 }
 
-Pattern *PatternBuilder::makeInternal(PatternID id)
+bool PatternBuilder::isAvailable(PatternID id)
 {
-  Pattern *pat = generate(id);
-  if (!pat) {
-    ERROR_OUT_OF_MEMORY();
-    return nullptr;
+  return (id <= PATTERN_LAST) && (patternRegistry[id].factory != nullptr);
+}
+
+// the size and a hash of the params each pattern is made with, these are
+// worked out by making the pattern once the first time they are needed
+// so checking the params of a pattern never has to build another one
+struct DefaultParams
+{
+  bool known;
+  uint16_t size;
+  uint32_t hash;
+};
+static DefaultParams defaultParams[PATTERN_COUNT];
+
+// the same hash as the crc of a serial buffer
+static uint32_t paramsHash(const uint8_t *params, uint32_t size)
+{
+  uint32_t hash = 5381;
+  for (uint32_t i = 0; i < size; ++i) {
+    hash = ((hash << 5) + hash) + params[i];
   }
-  // set private pattern ID via friend class relationship
-  pat->m_patternID = id;
-  return pat;
+  return hash;
 }
 
-// macros to create a PatternMap with a given PatternID and some preset LedMaps
-#define oddTipsPattern(pattern) PatternMap(pattern, MAP_FINGER_ODD_TIPS)
-#define oddTopsPattern(pattern) PatternMap(pattern, MAP_FINGER_ODD_TOPS)
-#define evenTipsPattern(pattern) PatternMap(pattern, MAP_FINGER_EVEN_TIPS)
-#define evenTopsPattern(pattern) PatternMap(pattern, MAP_FINGER_EVEN_TOPS)
+bool PatternBuilder::isDefaultParams(PatternID id, const uint8_t *params, uint32_t size)
+{
+  if (id > PATTERN_LAST) {
+    return false;
+  }
+  DefaultParams &defaults = defaultParams[id];
+  if (!defaults.known) {
+    Pattern *pat = make(id);
+    if (!pat) {
+      return false;
+    }
+    SerialBuffer buffer;
+    pat->serialize(buffer);
+    uint32_t start = pat->getColorset()->serializedSize();
+    delete pat;
+    if (buffer.size() < start) {
+      return false;
+    }
+    defaults.size = (uint16_t)(buffer.size() - start);
+    defaults.hash = paramsHash(buffer.data() + start, defaults.size);
+    defaults.known = true;
+  }
+  return size == defaults.size && paramsHash(params, size) == defaults.hash;
+}
 
-Pattern *createTheaterChase()
+uint8_t PatternBuilder::toWireID(PatternID id)
 {
-  Sequence theaterChaseSequence;
-  PatternMap patMap;
-  // there are 10 steps in the theater chase
-  for (uint32_t i = 0; i < 10; ++i) {
-    if (i < 5) {
-      // the first 5 steps are odd tips/tops alternating each step
-      patMap = (i % 2) ? oddTopsPattern(PATTERN_DOPS) : oddTipsPattern(PATTERN_DOPS);
-    } else {
-      // the end 5 steps are even tips/tops alternating each step
-      patMap = (i % 2) ? evenTopsPattern(PATTERN_DOPS) : evenTipsPattern(PATTERN_DOPS);
+  if (id > PATTERN_LAST) {
+    return (uint8_t)PATTERN_NONE;
+  }
+  return patternRegistry[id].wireID;
+}
+
+PatternID PatternBuilder::fromWireID(uint8_t wireID)
+{
+  for (uint32_t i = 0; i < PATTERN_COUNT; ++i) {
+    if (patternRegistry[i].wireID == wireID) {
+      return (PatternID)i;
     }
-    // each step is 25ms long
-    theaterChaseSequence.addStep(25, patMap);
   }
-  return new SequencedPattern(theaterChaseSequence);
+  return PATTERN_NONE;
 }
 
-Pattern *createChaser()
+Pattern *PatternBuilder::makeInternal(PatternID id)
 {
-  Sequence chaserSequence;
-  // there are 8 steps in the chaser
-  for (uint32_t i = 0; i < 8; ++i) {
-    // each step starts all fingers are dops
-    PatternMap patMap(PATTERN_DOPS);
-    // and one finger that moves back and forth is solid
-    patMap.setPatternAt(PATTERN_SOLID, MAP_FINGER((Finger)((i < 5) ? i : (8 - i))));
-    // the step lasts for 300ms
-    chaserSequence.addStep(300, patMap);
+  Pattern *pat = generate(id);
+  if (!pat) {
+    return nullptr;
   }
-  return new SequencedPattern(chaserSequence);
+  // set private pattern ID via friend class relationship
+  pat->m_patternID = id;
+  return pat;
 }
 
 Pattern *PatternBuilder::generate(PatternID id)
 {
-  // NOTE: The timings of patterns are only defined at creation time
-  //       which means altering the tickrate will not change how fast
-  //       a pattern displays unless you re-create it
-  switch (id) {
-    case PATTERN_STROBE: return new BasicPattern(5, 8);
-    case PATTERN_SOLID: return new SolidPattern(0, 20);
-    case PATTERN_HYPERSTROBE: return new BasicPattern(25, 25);
-    case PATTERN_DOPS: return new BasicPattern(2, 13);
-    case PATTERN_DOPISH: return new BasicPattern(2, 7);
-    case PATTERN_ULTRADOPS: return new BasicPattern(1, 3);
-    case PATTERN_STROBIE: return new BasicPattern(3, 22);
-    case PATTERN_RIBBON: return new BasicPattern(20);
-  #if 0
-    case PATTERN_MINIRIBBON: return new BasicPattern(3);
-  #endif
-    case PATTERN_TRACER: return new TracerPattern();
-    case PATTERN_BLINKIE: return new BasicPattern(5, 8, 35);
-    case PATTERN_GHOSTCRUSH: return new BasicPattern(1, 0, 50);
-    case PATTERN_ADVANCED: return new AdvancedPattern(5, 5, 10, 2, 2, 1);
-    case PATTERN_BLEND: return new BlendPattern();
-    case PATTERN_RECIPROCAL_BLEND: return new ReciprocalBlendPattern();
-    case PATTERN_BRACKETS: return new BracketsPattern();
-    case PATTERN_RABBIT: return new RabbitPattern();
-    case PATTERN_HUESHIFT: return new HueShiftPattern();
-    case PATTERN_THEATER_CHASE: return createTheaterChase();
-    case PATTERN_CHASER: return createChaser();
-    default: break;
+  const PatternEntry &entry = patternRegistry[id];
+  if (!entry.factory) {
+    DEBUG_LOGF("Pattern %u is not built in", id);
+    return nullptr;
+  }
+  Pattern *pat = entry.factory();
+  if (!pat) {
+    ERROR_OUT_OF_MEMORY();
+    return nullptr;
   }
-  DEBUG_LOGF("Unknown pattern id: %u", id);
-  return nullptr;
+  return pat;
 }
@@ -5,6 +5,7 @@
 
 class Pattern;
 class SerialBuffer;
+class SerialBufferView;
 class MultiLedPattern;
 class SingleLedPattern;
 
@@ -20,8 +21,22 @@ public:
   // generate a multi LED pattern (nullptr if patternid is not multi LED)
   static MultiLedPattern *makeMulti(PatternID id);
 
+  // serialize a pattern along with its wire id so that unserialize
+  // knows which pattern to instantiate
+  static void serialize(const Pattern *pat, SerialBuffer &buffer);
   // unserialize a buffer into a pattern
-  static Pattern *unserialize(SerialBuffer &buffer);
+  static Pattern *unserialize(SerialBufferView &buffer);
+
+  // whether the pattern is built into this firmware
+  static bool isAvailable(PatternID id);
+
+  // whether the serialized params of a pattern are the same as the ones
+  // it's made with, the params are everything after the colorset
+  static bool isDefaultParams(PatternID id, const uint8_t *params, uint32_t size);
+
+  // convert to and from the stable ids used in saves and over IR
+  static uint8_t toWireID(PatternID id);
+  static PatternID fromWireID(uint8_t wireID);
 
 private:
   // helper routines
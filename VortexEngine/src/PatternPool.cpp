@@ -0,0 +1,103 @@
+#include "PatternPool.h"
+
+#include "patterns/single/BasicPattern.h"
+#include "patterns/single/SolidPattern.h"
+#include "patterns/single/TracerPattern.h"
+#include "patterns/single/AdvancedPattern.h"
+#include "patterns/single/BlendPattern.h"
+#include "patterns/single/ReciprocalBlendPattern.h"
+#include "patterns/single/BracketsPattern.h"
+#include "patterns/multi/RabbitPattern.h"
+#include "patterns/multi/HueShiftPattern.h"
+#include "patterns/multi/SequencedPattern.h"
+#include "patterns/multi/TheaterChasePattern.h"
+
+#include "Memory.h"
+#include "Log.h"
+
+// the size of the largest of the given types
+template<typename T>
+constexpr size_t largestSize()
+{
+  return sizeof(T);
+}
+template<typename T, typename Next, typename... Rest>
+constexpr size_t largestSize()
+{
+  return (sizeof(T) > largestSize<Next, Rest...>()) ? sizeof(T) : largestSize<Next, Rest...>();
+}
+
+// every slot is big enough to fit any pattern that can be built, any new
+// pattern types need to be added here or they will be put on the heap
+#define PATTERN_SLOT_SIZE largestSize<BasicPattern, SolidPattern, TracerPattern, \
+  AdvancedPattern, BlendPattern, ReciprocalBlendPattern, BracketsPattern, \
+  RabbitPattern, HueShiftPattern, SequencedPattern, TheaterChasePattern>()
+
+// a slot is either holding a pattern or it's on the free list
+union PatternSlot
+{
+  PatternSlot *next;
+  // make sure the pattern in the slot is aligned like it would be on the heap
+  uint64_t align;
+  uint8_t data[PATTERN_SLOT_SIZE];
+};
+
+static PatternSlot slots[PATTERN_POOL_SLOTS];
+// slots that were used and then released
+static PatternSlot *freeList = nullptr;
+// slots past this index have never been used, this means the pool
+// doesn't need to be initialized before patterns can be built
+static uint32_t numTouched = 0;
+
+uint32_t PatternPool::m_used = 0;
+uint32_t PatternPool::m_highWater = 0;
+uint32_t PatternPool::m_overflows = 0;
+
+void *PatternPool::alloc(size_t size)
+{
+  PatternSlot *slot = nullptr;
+  if (size <= sizeof(PatternSlot)) {
+    if (freeList) {
+      slot = freeList;
+      freeList = slot->next;
+    } else if (numTouched < PATTERN_POOL_SLOTS) {
+      slot = slots + numTouched++;
+    }
+  }
+  if (!slot) {
+    // the pool is full or this is some pattern that doesn't fit
+    DEBUG_LOGF("Pattern pool overflow: %u bytes", size);
+    m_overflows++;
+    return vmalloc(size);
+  }
+  m_used++;
+  if (m_used > m_highWater) {
+    m_highWater = m_used;
+  }
+  return slot->data;
+}
+
+void PatternPool::release(void *ptr)
+{
+  if (!ptr) {
+    return;
+  }
+  if (!owns(ptr)) {
+    vfree(ptr);
+    return;
+  }
+  PatternSlot *slot = (PatternSlot *)ptr;
+  slot->next = freeList;
+  freeList = slot;
+  m_used--;
+}
+
+bool PatternPool::owns(const void *ptr)
+{
+  return ptr >= (const void *)slots && ptr < (const void *)(slots + PATTERN_POOL_SLOTS);
+}
+
+size_t PatternPool::slotSize()
+{
+  return sizeof(PatternSlot);
+}
@@ -0,0 +1,61 @@
+#ifndef PATTERN_POOL_H
+#define PATTERN_POOL_H
+
+#include <inttypes.h>
+#include <stddef.h>
+
+#include "LedTypes.h"
+#include "VortexConfig.h"
+
+// the number of patterns the pool can hold at once, every slot is ram
+// that is reserved for good so this only covers the usual case: a full
+// mode for each mode in the mode cache plus the demo mode of the menus,
+// which is a pattern for every led or a multi led pattern holding one
+// for every led. Sequenced patterns and anything else past that are
+// allocated from the heap instead, a build with more ram to spare can
+// define this to fit more
+#ifndef PATTERN_POOL_SLOTS
+#define PATTERN_POOL_SLOTS ((MODE_CACHE_SIZE + 1) * (LED_COUNT + 1))
+#endif
+
+// A fixed pool of equally sized slots that every Pattern is allocated from
+//
+// Patterns are created and destroyed constantly (mode switches, sequenced
+// pattern steps) and come in a handful of different sizes which would
+// fragment the heap, instead every slot is the size of the largest pattern
+// so any pattern fits in any free slot and allocating is just popping the
+// head of the free list
+class PatternPool
+{
+  // private unimplemented constructor
+  PatternPool();
+
+public:
+  // allocate space for a pattern of the given size, falls back to the
+  // heap if the pool is full or the size doesn't fit in a slot
+  static void *alloc(size_t size);
+  // release space allocated by alloc
+  static void release(void *ptr);
+
+  // whether the pointer is a slot of the pool
+  static bool owns(const void *ptr);
+
+  // the size of each slot and the total number of slots
+  static size_t slotSize();
+  static uint32_t capacity() { return PATTERN_POOL_SLOTS; }
+
+  // the number of slots currently in use
+  static uint32_t used() { return m_used; }
+  // the most slots that have ever been in use at once
+  static uint32_t highWater() { return m_highWater; }
+  static void resetHighWater() { m_highWater = m_used; }
+  // the number of patterns that had to be allocated from the heap
+  static uint32_t overflows() { return m_overflows; }
+
+private:
+  static uint32_t m_used;
+  static uint32_t m_highWater;
+  static uint32_t m_overflows;
+};
+
+#endif
@@ -3,6 +3,17 @@
 
 #include <inttypes.h>
 
+// Disabled Patterns
+//
+// A mask of pattern ids to leave out of the build to save flash, for
+// example: ((1ul << PATTERN_BLEND) | (1ul << PATTERN_CHASER))
+//
+// The ids of disabled patterns are still reserved so everything else
+// keeps the same id, they just can't be built by this firmware
+#ifndef PATTERNS_DISABLED
+#define PATTERNS_DISABLED 0
+#endif
+
 // list of patterns that can be built
 enum PatternID : uint8_t
 {
@@ -37,9 +48,9 @@ enum PatternID : uint8_t
   PATTERN_BRACKETS,  // BracketsPattern
 
   // ADD NEW SINGLE LED PATTERNS HERE
-  // WARNING This will offset all multi-led patterns so IR sharing
-  //         of patterns will be misaligned. This means there will
-  //         be inconsistencies sharing patterns over IR.
+  // NOTE: This will offset the ids of all multi-led patterns, saves and
+  //       IR use the wire ids from the registry in PatternBuilder.cpp so
+  //       give the new pattern the next unused wire id there
 
   // =====================================
   //  Pattern Meta Constants:
@@ -56,6 +67,7 @@ enum PatternID : uint8_t
   PATTERN_CHASER,
 
   // ADD NEW MULTI LED PATTERNS HERE
+  // (and give them the next unused wire id in PatternBuilder.cpp)
 
   // =====================================
   INTERNAL_PATTERNS_END, // <<< DON'T USE OR TOUCH THIS ONE
@@ -66,8 +78,8 @@ enum PatternID : uint8_t
 };
 
 // some helper functions to improve readability
-inline bool isMultiLedPatternID(PatternID id) { return id >= PATTERN_MULTI_FIRST; }
-inline bool isSingleLedPatternID(PatternID id) { return id < PATTERN_MULTI_FIRST; }
+constexpr bool isMultiLedPatternID(PatternID id) { return id >= PATTERN_MULTI_FIRST; }
+constexpr bool isSingleLedPatternID(PatternID id) { return id < PATTERN_MULTI_FIRST; }
 
 // PatternID operators
 inline PatternID &operator++(PatternID &c)
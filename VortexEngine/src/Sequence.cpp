@@ -1,6 +1,8 @@
 #include "Sequence.h"
 
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
+#include "PatternBuilder.h"
 #include "Memory.h"
 #include "Leds.h"
 #include "Log.h"
@@ -40,15 +42,15 @@ PatternID PatternMap::operator[](LedPos index) const
 void PatternMap::serialize(SerialBuffer &buffer) const
 {
   for (uint32_t i = 0; i < LED_COUNT; ++i) {
-    // ensure the PatternID is interpreted as uint8_t
-    buffer.serialize((uint8_t)m_patternMap[i]);
+    // the wire id stays the same if the PatternIDs are reordered
+    buffer.serialize(PatternBuilder::toWireID(m_patternMap[i]));
   }
 }
 
-void PatternMap::unserialize(SerialBuffer &buffer)
+void PatternMap::unserialize(SerialBufferView &buffer)
 {
   for (uint32_t i = 0; i < LED_COUNT; ++i) {
-    buffer.unserialize((uint8_t *)m_patternMap + i);
+    m_patternMap[i] = PatternBuilder::fromWireID(buffer.unserialize8());
   }
 }
 
@@ -84,7 +86,7 @@ void ColorsetMap::serialize(SerialBuffer &buffer) const
   }
 }
 
-void ColorsetMap::unserialize(SerialBuffer &buffer)
+void ColorsetMap::unserialize(SerialBufferView &buffer)
 {
   for (uint32_t i = 0; i < LED_COUNT; ++i) {
     m_colorsetMap[i].unserialize(buffer);
@@ -112,7 +114,7 @@ void SequenceStep::serialize(SerialBuffer &buffer) const
   m_colorsetMap.serialize(buffer);
 }
 
-void SequenceStep::unserialize(SerialBuffer &buffer)
+void SequenceStep::unserialize(SerialBufferView &buffer)
 {
   buffer.unserialize(&m_duration);
   m_patternMap.unserialize(buffer);
@@ -228,9 +230,18 @@ void Sequence::serialize(SerialBuffer &buffer) const
   }
 }
 
-void Sequence::unserialize(SerialBuffer &buffer)
+void Sequence::unserialize(SerialBufferView &buffer)
 {
-  buffer.unserialize(&m_numSteps);
+  uint32_t numSteps = 0;
+  buffer.unserialize(&numSteps);
+  if (numSteps > MAX_SEQUENCE_STEPS) {
+    ERROR_LOGF("Sequence has too many steps: %u", numSteps);
+    return;
+  }
+  // the steps are only allocated if there is a different number of them
+  if (numSteps != m_numSteps) {
+    initSteps(numSteps);
+  }
   for (uint32_t i = 0; i < m_numSteps; ++i) {
     m_sequenceSteps[i].unserialize(buffer);
   }
@@ -9,6 +9,7 @@
 class SequencedPattern;
 class SingleLedPattern;
 class SerialBuffer;
+class SerialBufferView;
 
 // a map of leds to pattern ids
 class PatternMap
@@ -23,7 +24,7 @@ public:
 
   // serialize and unserialize a pattern map
   void serialize(SerialBuffer &buffer) const;
-  void unserialize(SerialBuffer &buffer);
+  void unserialize(SerialBufferView &buffer);
 
   // public list of pattern IDs for each led
   PatternID m_patternMap[LED_COUNT];
@@ -42,7 +43,7 @@ public:
 
   // serialize and unserialize a colorset map
   void serialize(SerialBuffer &buffer) const;
-  void unserialize(SerialBuffer &buffer);
+  void unserialize(SerialBufferView &buffer);
 
   // public list of pattern IDs for each led
   Colorset m_colorsetMap[LED_COUNT];
@@ -58,7 +59,7 @@ public:
 
   // serialize and unserialize a step in the sequencer
   void serialize(SerialBuffer &buffer) const;
-  void unserialize(SerialBuffer &buffer);
+  void unserialize(SerialBufferView &buffer);
 
   // public members to allow for easy initialization of an array of SequenceSteps
   uint16_t m_duration;
@@ -86,7 +87,7 @@ public:
   void clear();
 
   void serialize(SerialBuffer &buffer) const;
-  void unserialize(SerialBuffer &buffer);
+  void unserialize(SerialBufferView &buffer);
 
   uint32_t numSteps() const;
   const SequenceStep &operator[](uint32_t index) const;
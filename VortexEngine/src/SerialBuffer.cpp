@@ -1,5 +1,7 @@
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
 
+#include "Compression.h"
 #include "BitStream.h"
 #include "Memory.h"
 #include "Log.h"
@@ -7,9 +9,6 @@
 #include <FlashStorage.h>
 #include <string.h>
 
-// flags for saving buffer to disk
-#define BUFFER_FLAG_COMRPESSED (1<<0)
-
 SerialBuffer::SerialBuffer(uint32_t size, const uint8_t *buf) :
   m_pData(),
   m_position(0),
@@ -23,17 +22,22 @@ SerialBuffer::~SerialBuffer()
   clear();
 }
 
-SerialBuffer::SerialBuffer(const SerialBuffer &other)
+SerialBuffer::SerialBuffer(const SerialBuffer &other) :
+  m_pData(),
+  m_position(0),
+  m_capacity(0)
 {
-  init(other.capacity(), other.data());
-  m_pData->flags = other.m_pData->flags;
-  m_pData->crc32 = other.m_pData->crc32;
-  m_pData->size = other.m_pData->size;
+  *this = other;
 }
 
 void SerialBuffer::operator=(const SerialBuffer &other)
 {
-  init(other.capacity(), other.data());
+  // only copy the data, the capacity is rounded up again by init
+  // so it can be bigger than the other buffer
+  if (!init(other.capacity()) || !m_pData || !other.m_pData) {
+    return;
+  }
+  memcpy(m_pData->buf, other.m_pData->buf, other.m_pData->size);
   m_pData->flags = other.m_pData->flags;
   m_pData->crc32 = other.m_pData->crc32;
   m_pData->size = other.m_pData->size;
@@ -168,101 +172,44 @@ bool SerialBuffer::compress()
     DEBUG_LOG("Data is already compressed");
     return true;
   }
-#if 0
-  printf("COMPRESSING:\n");
-  for (uint32_t i = 0; i < m_pData->size; ++i) {
-    printf("%02x ", m_pData->buf[i]);
-    if (i > 0 && ((i + 1) % 32) == 0) {
-      printf("\r\n\t");
-    }
+  uint32_t old_size = m_pData->size;
+  if (old_size <= LZ_HEADER_SIZE || old_size > Compression::maxInput()) {
+    // NOT A FAILURE, buffer simply not compressed but the crc still
+    // needs to be right for whoever decompresses it
+    m_pData->recalc_crc();
+    return true;
   }
-  printf("\r\n\r\n");
-#endif
-  uint8_t bytes[256] = {0};
-  uint8_t unique_bytes = 0;
-  // count the unique bytes in the data buffer
-  for (uint32_t i = 0; i < m_pData->size; ++i) {
-    uint8_t b = m_pData->buf[i] & 0xFF;
-    if (bytes[b]) {
-      continue;
-    }
-    bytes[b] = 1;
-    unique_bytes++;
+  // only worth keeping if it comes out smaller
+  uint32_t max_size = old_size - LZ_HEADER_SIZE - 1;
+  uint8_t *out = (uint8_t *)vmalloc(LZ_HEADER_SIZE + max_size);
+  if (!out) {
+    ERROR_OUT_OF_MEMORY();
+    return false;
   }
-  // table = num_entries + entries[]
-  uint32_t table_size = sizeof(uint8_t) + (sizeof(uint8_t) * unique_bytes);
-  uint32_t wid = getWidth(unique_bytes - 1);
-  // data = width(num_entries) * size
-  uint32_t data_size = ((wid * m_pData->size) + 7) / 8;
-  // total = table + data
-  uint32_t total_size = table_size + data_size;
-  uint32_t old_size = m_pData->size;
-  if (total_size >= old_size) {
-    DEBUG_LOGF("new size larger: %u old: %u", total_size, m_pData->size);
-    DEBUG_LOGF("\tUnique bytes: %u", unique_bytes);
-    DEBUG_LOGF("\twidth: %u", wid);
-    DEBUG_LOGF("\tTable size: %u", table_size);
-    DEBUG_LOGF("\tData size: %u", data_size);
+  uint32_t margin = 0;
+  uint32_t data_size = Compression::compress(m_pData->buf, old_size,
+    out + LZ_HEADER_SIZE, max_size, &margin);
+  if (!data_size || margin > 0xFF) {
+    DEBUG_LOGF("Did not compress %u bytes", old_size);
+    vfree(out);
     // NOT A FAILURE, buffer simply not compressed
+    m_pData->recalc_crc();
     return true;
   }
-  // extend enough for two tables
-  extend(table_size * 2);
-  // put table at end of buffer, in newly extended region
-  uint8_t *table = (m_pData->buf + m_capacity) - table_size;
-  // the number of unique bytes (table size)
-  table[0] = unique_bytes;
-  // the table data index starts offset at 0
-  uint32_t b = 0;
-  // walk all 256 bytes and mirror them in the table
-  for (uint32_t i = 0; i < 256; ++i) {
-    if (!bytes[i]) {
-      continue;
-    }
-    if (b > unique_bytes) {
-      ERROR_LOG("ERROR IN COMPRESSION");
-      return false;
-    }
-    bytes[i] = b;
-    table[++b] = i;
-  }
-
-  BitStream bits(m_pData->buf, data_size);
-
-  for (uint32_t i = 0; i < old_size; ++i) {
-    uint32_t b = m_pData->buf[i];
-    // zero out the current byte so the bits can be written
-    m_pData->buf[i] = 0;
-    // compressed version of the current byte
-    uint32_t compressed = bytes[b];
-    // write the compressed b with width
-    bits.writeBits(wid, compressed);
-    //DEBUG_LOGF("Compressed %u -> %u", b, compressed);
-  }
-
-  // move the data forward
-  memmove(m_pData->buf + table_size, m_pData->buf, data_size);
-  // move the table back
-  memmove(m_pData->buf, (m_pData->buf + m_capacity) - table_size, table_size);
-  // update the size of the buffer
-  m_pData->size = table_size + ((bits.bitpos() + 7) / 8);
-  // buffer is no longer compressed
-  m_pData->flags |= BUFFER_FLAG_COMRPESSED;
+  out[0] = old_size & 0xFF;
+  out[1] = (old_size >> 8) & 0xFF;
+  out[2] = (uint8_t)margin;
+  // the compressed data always fits in the existing buffer
+  memcpy(m_pData->buf, out, LZ_HEADER_SIZE + data_size);
+  vfree(out);
+  m_pData->size = LZ_HEADER_SIZE + data_size;
+  // buffer is now compressed
+  m_pData->flags |= BUFFER_FLAG_LZ_COMPRESSED;
   // recalc the crc on the data buffer
   m_pData->recalc_crc();
   // shrink to the size of the buffer
   shrink();
   DEBUG_LOGF("Compressed %u to %u bytes", old_size, m_pData->size);
-#if 0
-  printf("COMPRESSED:\n");
-  for (uint32_t i = 0; i < m_pData->size; ++i) {
-    printf("%02x ", m_pData->buf[i]);
-    if (i > 0 && ((i + 1) % 32) == 0) {
-      printf("\r\n\t");
-    }
-  }
-  printf("\r\n\r\n");
-#endif
   return true;
 }
 
@@ -277,79 +224,89 @@ bool SerialBuffer::decompress()
     DEBUG_LOG("Data is already decompressed");
     return true;
   }
-#if 0
-  printf("DECOMPRESSING:\n");
-  for (uint32_t i = 0; i < m_pData->size; ++i) {
-    printf("%02x ", m_pData->buf[i]);
-    if (i > 0 && ((i + 1) % 32) == 0) {
-      printf("\r\n\t");
-    }
+  if (m_pData->flags & BUFFER_FLAG_COMRPESSED) {
+    return decompressTable();
   }
-  printf("\r\n\r\n");
-#endif
-  // WARNING: need to extend buffer more maybe?
-  resetUnserializer();
-  uint8_t unique_bytes = unserialize8();
-  uint8_t *table = m_pData->buf + 1;
-  uint8_t *data = table + unique_bytes;
-  uint8_t *data_end = m_pData->buf + m_pData->size;
-  uint32_t wid = getWidth(unique_bytes - 1);
-  uint32_t data_len = (uint32_t)(data_end - data);
-
-  if (!data_len) {
+  if (m_pData->size < LZ_HEADER_SIZE) {
     DEBUG_LOG("No data to decompress");
     return false;
   }
-
-  uint32_t expected_inflated_len = ((data_len / wid) + 1) * 8;
-
-  DEBUG_LOGF("Expected Inflated length: %u", expected_inflated_len);
-
-  // TODO: do this without allocating a new buffer, just extend the data
-  uint8_t *out_data = new uint8_t[expected_inflated_len];
-  memset(out_data, 0, expected_inflated_len);
-
-  BitStream bits(data, data_len);
-
-  uint32_t outPos = 0;
-  while (!bits.eof()) {
-    uint32_t val = bits.readBits(wid);
-    if (bits.eof()) {
-      break;
+  uint32_t old_size = m_pData->size;
+  uint32_t new_size = m_pData->buf[0] | (m_pData->buf[1] << 8);
+  uint32_t margin = m_pData->buf[2];
+  uint32_t data_size = old_size - LZ_HEADER_SIZE;
+  if (data_size > new_size + margin) {
+    DEBUG_LOG("Bad compressed size");
+    return false;
+  }
+  // make room for the output and the margin past the end of it
+  if ((new_size + margin) > m_capacity) {
+    if (!extend((new_size + margin) - m_capacity)) {
+      return false;
     }
-    // the table is one byte in
-    out_data[outPos] = table[val];
-    //DEBUG_LOGF("Decompressed [%u] %u -> %u (%u / %u)", outPos, val, out_data[outPos], bits.bitpos(), bits.size() * 8);
-    outPos++;
   }
-  uint32_t old_size = (uint32_t)(data_end - m_pData->buf);
-  if (outPos > m_capacity) {
-    extend(outPos - m_capacity);
+  // move the compressed data to end at the margin then decompress it
+  // forward over itself from the front of the buffer
+  uint8_t *data = m_pData->buf + (new_size + margin) - data_size;
+  memmove(data, m_pData->buf + LZ_HEADER_SIZE, data_size);
+  if (!Compression::decompress(data, data_size, m_pData->buf, new_size)) {
+    // the data passed the crc so this can only be a bug in the codec,
+    // whatever was in the buffer is lost now
+    ERROR_LOG("Failed to decompress buffer");
+    m_pData->size = 0;
+    return false;
   }
-  // copy the data in
-  memmove(m_pData->buf, out_data, outPos);
-  // cleanup temp buffer
-  delete[] out_data;
   // size changed
-  m_pData->size = outPos;
+  m_pData->size = new_size;
   // data is no longer compressed
-  m_pData->flags &= ~BUFFER_FLAG_COMRPESSED;
+  m_pData->flags &= ~BUFFER_FLAG_LZ_COMPRESSED;
   // recalc crc of buffer
   m_pData->recalc_crc();
   DEBUG_LOGF("Decompressed %u to %u bytes (%u capacity)", old_size, m_pData->size, m_capacity);
   shrink();
-  // this shouldn't be necessary:
   resetUnserializer();
-#if 0
-  printf("DECOMPRESSED:\n");
-  for (uint32_t i = 0; i < m_pData->size; ++i) {
-    printf("%02x ", m_pData->buf[i]);
-    if (i > 0 && ((i + 1) % 32) == 0) {
-      printf("\r\n\t");
+  return true;
+}
+
+bool SerialBuffer::decompress(const SerialBufferView &view)
+{
+  clear();
+  if (!(view.flags() & BUFFER_FLAG_LZ_COMPRESSED)) {
+    // copy the data in, the byte table packing is then decompressed
+    // in place like before and anything else is already decompressed
+    if (!view.size()) {
+      return true;
     }
+    if (!init(view.size())) {
+      return false;
+    }
+    memcpy(m_pData->buf, view.data(), view.size());
+    m_pData->size = view.size();
+    m_pData->flags = view.flags();
+    m_pData->recalc_crc();
+    return decompress();
   }
-  printf("\r\n\r\n");
-#endif
+  if (view.size() < LZ_HEADER_SIZE) {
+    DEBUG_LOG("No data to decompress");
+    return false;
+  }
+  const uint8_t *data = view.data();
+  uint32_t new_size = data[0] | (data[1] << 8);
+  if (!init(new_size) || !m_pData) {
+    return false;
+  }
+  // the view isn't touched so no margin is needed to decompress it
+  if (!Compression::decompress(data + LZ_HEADER_SIZE, view.size() - LZ_HEADER_SIZE,
+      m_pData->buf, new_size)) {
+    ERROR_LOG("Failed to decompress view");
+    clear();
+    return false;
+  }
+  m_pData->size = new_size;
+  m_pData->flags = view.flags() & ~BUFFER_FLAG_LZ_COMPRESSED;
+  m_pData->recalc_crc();
+  DEBUG_LOGF("Decompressed %u to %u bytes from view", view.size(), new_size);
+  resetUnserializer();
   return true;
 }
 
@@ -393,6 +350,17 @@ bool SerialBuffer::serialize(uint32_t bytes)
   return true;
 }
 
+bool SerialBuffer::serializeVarint(uint32_t value)
+{
+  while (value >= 0x80) {
+    if (!serialize((uint8_t)(value | 0x80))) {
+      return false;
+    }
+    value >>= 7;
+  }
+  return serialize((uint8_t)value);
+}
+
 // reset the unserializer index so that unserialization will
 // begin from the start of the buffer
 void SerialBuffer::resetUnserializer()
@@ -519,12 +487,92 @@ SerialBuffer &SerialBuffer::operator+=(const uint32_t &rhs)
 }
 
 
+// unpack data that was compressed by older firmware which put each byte
+// in a table and packed the indexes of the table into as few bits as fit
+bool SerialBuffer::decompressTable()
+{
+#if 0
+  printf("DECOMPRESSING:\n");
+  for (uint32_t i = 0; i < m_pData->size; ++i) {
+    printf("%02x ", m_pData->buf[i]);
+    if (i > 0 && ((i + 1) % 32) == 0) {
+      printf("\r\n\t");
+    }
+  }
+  printf("\r\n\r\n");
+#endif
+  // WARNING: need to extend buffer more maybe?
+  resetUnserializer();
+  uint8_t unique_bytes = unserialize8();
+  uint8_t *table = m_pData->buf + 1;
+  uint8_t *data = table + unique_bytes;
+  uint8_t *data_end = m_pData->buf + m_pData->size;
+  uint32_t wid = getWidth(unique_bytes - 1);
+  uint32_t data_len = (uint32_t)(data_end - data);
+
+  if (!data_len) {
+    DEBUG_LOG("No data to decompress");
+    return false;
+  }
+
+  uint32_t expected_inflated_len = ((data_len / wid) + 1) * 8;
+
+  DEBUG_LOGF("Expected Inflated length: %u", expected_inflated_len);
+
+  // TODO: do this without allocating a new buffer, just extend the data
+  uint8_t *out_data = new uint8_t[expected_inflated_len];
+  memset(out_data, 0, expected_inflated_len);
+
+  BitStream bits(data, data_len);
+
+  uint32_t outPos = 0;
+  while (!bits.eof()) {
+    uint32_t val = bits.readBits(wid);
+    if (bits.eof()) {
+      break;
+    }
+    // the table is one byte in
+    out_data[outPos] = table[val];
+    //DEBUG_LOGF("Decompressed [%u] %u -> %u (%u / %u)", outPos, val, out_data[outPos], bits.bitpos(), bits.size() * 8);
+    outPos++;
+  }
+  uint32_t old_size = (uint32_t)(data_end - m_pData->buf);
+  if (outPos > m_capacity) {
+    extend(outPos - m_capacity);
+  }
+  // copy the data in
+  memmove(m_pData->buf, out_data, outPos);
+  // cleanup temp buffer
+  delete[] out_data;
+  // size changed
+  m_pData->size = outPos;
+  // data is no longer compressed
+  m_pData->flags &= ~BUFFER_FLAG_COMRPESSED;
+  // recalc crc of buffer
+  m_pData->recalc_crc();
+  DEBUG_LOGF("Decompressed %u to %u bytes (%u capacity)", old_size, m_pData->size, m_capacity);
+  shrink();
+  // this shouldn't be necessary:
+  resetUnserializer();
+#if 0
+  printf("DECOMPRESSED:\n");
+  for (uint32_t i = 0; i < m_pData->size; ++i) {
+    printf("%02x ", m_pData->buf[i]);
+    if (i > 0 && ((i + 1) % 32) == 0) {
+      printf("\r\n\t");
+    }
+  }
+  printf("\r\n\r\n");
+#endif
+  return true;
+}
+
 bool SerialBuffer::is_compressed() const
 {
   if (!m_pData) {
     return false;
   }
-  return (m_pData->flags & BUFFER_FLAG_COMRPESSED) != 0;
+  return (m_pData->flags & (BUFFER_FLAG_COMRPESSED | BUFFER_FLAG_LZ_COMPRESSED)) != 0;
 }
 
 bool SerialBuffer::largeEnough(uint32_t amount) const
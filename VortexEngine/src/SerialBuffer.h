@@ -3,11 +3,22 @@
 
 #include <inttypes.h>
 
+// flags for saving buffer to disk, the first is the byte table
+// packing of older firmware which can only be decompressed now
+#define BUFFER_FLAG_COMRPESSED (1<<0)
+#define BUFFER_FLAG_LZ_COMPRESSED (1<<1)
+
+// compressed data starts with the 2 byte uncompressed size and the
+// 1 byte margin needed to decompress it in place
+#define LZ_HEADER_SIZE 3
+
 class FlashClass;
+class SerialBufferView;
 
 class SerialBuffer
 {
   friend class Storage;
+  friend class SerialBufferView;
 
 public:
   SerialBuffer(uint32_t size = 0, const uint8_t *buf = nullptr);
@@ -36,20 +47,27 @@ public:
   // extend the storage without changing the size of the data
   bool extend(uint32_t size);
 
-  // badly written in-place compression and decompression
-  // which just uses a table of values then compresses the
-  // data into indexes in the table packed into a buffer.
-  // Unfortunately sometimes compression does not yield a
-  // smaller buffer size, incases like this compress returns
-  // true but the data isn't compressed. Similarly, if that
-  // data is passed to decompress it will return true.
+  // compress the data with the LZ codec in Compression and
+  // decompress it again in place. If compression does not
+  // yield a smaller buffer then compress returns true but
+  // the data isn't compressed. Similarly, if that data is
+  // passed to decompress it will return true. Data that was
+  // compressed by older firmware with the byte table packing
+  // can still be decompressed
   bool compress();
   bool decompress();
+  // replace the buffer with the decompressed data of a view, the
+  // compressed data is read straight out of the view so only the
+  // output is allocated. Data that isn't compressed is just copied
+  bool decompress(const SerialBufferView &view);
 
   // serialize a byte into the buffer
   bool serialize(uint8_t byte);
   bool serialize(uint16_t bytes);
   bool serialize(uint32_t bytes);
+  // serialize a value as a LEB128 varint, 7 bits per byte with the high
+  // bit set on every byte but the last, so small values take 1 byte
+  bool serializeVarint(uint32_t value);
 
   // reset the unserializer index
   void resetUnserializer();
@@ -98,6 +116,7 @@ private:
   // don't expose this one it's dangerous
   uint8_t *frontSerializer() const { return m_pData ? m_pData->buf + m_pData->size : nullptr; }
   bool largeEnough(uint32_t amount) const;
+  bool decompressTable();
   uint32_t getWidth(uint32_t value);
 
   // inner data buffer
@@ -112,7 +131,7 @@ private:
   // the structure of raw data that's written to storage
   struct RawBuffer
   {
-    RawBuffer() : size(0), flags(0), crc32(5381), buf() {}
+    RawBuffer() : size(0), flags(0), crc32(5381) {}
     // hash the raw buffer into crc
     uint32_t hash()
     {
@@ -0,0 +1,194 @@
+#include "SerialBufferView.h"
+
+#include "SerialBuffer.h"
+#include "Log.h"
+
+#include <string.h>
+
+SerialBufferView::SerialBufferView(const uint8_t *buf, uint32_t size) :
+  m_buf(buf),
+  m_size(buf ? size : 0),
+  m_flags(0),
+  m_position(0)
+{
+}
+
+SerialBufferView::SerialBufferView(const SerialBuffer &buffer) :
+  m_buf(buffer.data()),
+  m_size(buffer.size()),
+  m_flags(buffer.m_pData ? buffer.m_pData->flags : 0),
+  m_position(0)
+{
+}
+
+bool SerialBufferView::rawInit(const uint8_t *rawdata, uint32_t size)
+{
+  m_buf = nullptr;
+  m_size = 0;
+  m_flags = 0;
+  m_position = 0;
+  if (!rawdata || size < sizeof(SerialBuffer::RawBuffer)) {
+    return false;
+  }
+  // the header may not be aligned in the IR receive buffer
+  SerialBuffer::RawBuffer header;
+  memcpy(&header, rawdata, sizeof(header));
+  if (header.size > (size - sizeof(header))) {
+    DEBUG_LOGF("Bad raw buffer size: %u", header.size);
+    return false;
+  }
+  const uint8_t *buf = rawdata + sizeof(header);
+  // same as the crc of the serial buffer, 0 means it wasn't set
+  if (header.crc32) {
+    uint32_t hash = 5381;
+    for (uint32_t i = 0; i < header.size; ++i) {
+      hash = ((hash << 5) + hash) + buf[i];
+    }
+    if (hash != header.crc32) {
+      DEBUG_LOG("Cannot verify crc of raw buffer");
+      return false;
+    }
+  }
+  m_buf = buf;
+  m_size = header.size;
+  m_flags = header.flags;
+  return true;
+}
+
+// reset the unserializer index so that unserialization will
+// begin from the start of the data
+void SerialBufferView::resetUnserializer()
+{
+  m_position = 0;
+}
+
+// move the unserializer index manually
+void SerialBufferView::moveUnserializer(uint32_t idx)
+{
+  if (idx >= m_size) {
+    idx = 0;
+  }
+  m_position = idx;
+}
+
+bool SerialBufferView::skip(uint32_t amount)
+{
+  if (amount > (m_size - m_position)) {
+    m_position = m_size;
+    return false;
+  }
+  m_position += amount;
+  return true;
+}
+
+// unserialize data and walk the view that many bytes
+bool SerialBufferView::unserialize(uint8_t *byte)
+{
+  if (m_position >= m_size || (m_size - m_position) < sizeof(uint8_t)) {
+    return false;
+  }
+  memcpy(byte, m_buf + m_position, sizeof(uint8_t));
+  m_position += sizeof(uint8_t);
+  return true;
+}
+
+bool SerialBufferView::unserialize(uint16_t *bytes)
+{
+  if (m_position >= m_size || (m_size - m_position) < sizeof(uint16_t)) {
+    return false;
+  }
+  memcpy(bytes, m_buf + m_position, sizeof(uint16_t));
+  m_position += sizeof(uint16_t);
+  return true;
+}
+
+bool SerialBufferView::unserialize(uint32_t *bytes)
+{
+  if (m_position >= m_size || (m_size - m_position) < sizeof(uint32_t)) {
+    return false;
+  }
+  memcpy(bytes, m_buf + m_position, sizeof(uint32_t));
+  m_position += sizeof(uint32_t);
+  return true;
+}
+
+bool SerialBufferView::unserializeVarint(uint32_t *value)
+{
+  uint32_t result = 0;
+  // a 32 bit value never needs more than 5 bytes
+  for (uint32_t shift = 0; shift < 35; shift += 7) {
+    uint8_t byte = 0;
+    if (!unserialize(&byte)) {
+      return false;
+    }
+    result |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+  DEBUG_LOG("Varint is too long");
+  return false;
+}
+
+uint8_t SerialBufferView::unserialize8()
+{
+  uint8_t byte = 0;
+  unserialize(&byte);
+  return byte;
+}
+
+uint16_t SerialBufferView::unserialize16()
+{
+  uint16_t bytes = 0;
+  unserialize(&bytes);
+  return bytes;
+}
+
+uint32_t SerialBufferView::unserialize32()
+{
+  uint32_t bytes = 0;
+  unserialize(&bytes);
+  return bytes;
+}
+
+uint32_t SerialBufferView::unserializeVarint()
+{
+  uint32_t value = 0;
+  unserializeVarint(&value);
+  return value;
+}
+
+// the peeks read nothing past the end of the data since the memory
+// after it isn't owned by the view
+uint8_t SerialBufferView::peek8() const
+{
+  uint8_t byte = 0;
+  if (m_position < m_size && (m_size - m_position) >= sizeof(byte)) {
+    memcpy(&byte, m_buf + m_position, sizeof(byte));
+  }
+  return byte;
+}
+
+uint16_t SerialBufferView::peek16() const
+{
+  uint16_t bytes = 0;
+  if (m_position < m_size && (m_size - m_position) >= sizeof(bytes)) {
+    memcpy(&bytes, m_buf + m_position, sizeof(bytes));
+  }
+  return bytes;
+}
+
+uint32_t SerialBufferView::peek32() const
+{
+  uint32_t bytes = 0;
+  if (m_position < m_size && (m_size - m_position) >= sizeof(bytes)) {
+    memcpy(&bytes, m_buf + m_position, sizeof(bytes));
+  }
+  return bytes;
+}
+
+bool SerialBufferView::is_compressed() const
+{
+  return (m_flags & (BUFFER_FLAG_COMRPESSED | BUFFER_FLAG_LZ_COMPRESSED)) != 0;
+}
@@ -0,0 +1,70 @@
+#ifndef SERIAL_BUFFER_VIEW_H
+#define SERIAL_BUFFER_VIEW_H
+
+#include <inttypes.h>
+
+class SerialBuffer;
+
+// A read only view of serialized data that lives somewhere else
+//
+// The view unserializes straight out of memory it doesn't own, like the
+// flash or the buffer the IR receiver fills, so nothing is allocated or
+// copied to read it. The memory must stay the same as long as the view
+// is used, and compressed data still needs a SerialBuffer to go into
+class SerialBufferView
+{
+public:
+  SerialBufferView(const uint8_t *buf = nullptr, uint32_t size = 0);
+  // view the data of a serial buffer, the buffer must outlive the view
+  SerialBufferView(const SerialBuffer &buffer);
+
+  // point the view at a raw buffer as it was written by a serial buffer,
+  // this includes the size, flags, crc, and data and the crc is verified
+  bool rawInit(const uint8_t *rawdata, uint32_t size);
+
+  // reset the unserializer index
+  void resetUnserializer();
+  // move the unserializer index manually
+  void moveUnserializer(uint32_t idx);
+  // walk the unserializer past some data without reading it, if there
+  // isn't that much data left it stops at the end and returns false
+  bool skip(uint32_t amount);
+
+  // unserialize data from the view
+  bool unserialize(uint8_t *byte);
+  bool unserialize(uint16_t *bytes);
+  bool unserialize(uint32_t *bytes);
+  // unserialize a LEB128 varint written by SerialBuffer::serializeVarint
+  bool unserializeVarint(uint32_t *value);
+
+  // same thing but via return value
+  uint8_t unserialize8();
+  uint16_t unserialize16();
+  uint32_t unserialize32();
+  uint32_t unserializeVarint();
+
+  uint8_t peek8() const;
+  uint16_t peek16() const;
+  uint32_t peek32() const;
+
+  // return the members
+  const uint8_t *data() const { return m_buf; }
+  uint32_t size() const { return m_size; }
+  uint32_t flags() const { return m_flags; }
+  bool is_compressed() const;
+
+  // the data that will be unserialized next and how much is left
+  const uint8_t *frontUnserializer() const { return m_buf ? m_buf + m_position : nullptr; }
+  uint32_t remaining() const { return m_size - m_position; }
+
+private:
+  // the data being viewed
+  const uint8_t *m_buf;
+  uint32_t m_size;
+  // the flags of the raw buffer the data came from
+  uint32_t m_flags;
+  // the index in the data for unserialization
+  uint32_t m_position;
+};
+
+#endif
@@ -6,6 +6,7 @@
 
 #include "Memory.h"
 #include "SerialBuffer.h"
+#include "SerialBufferView.h"
 #include "Log.h"
 
 #ifdef TEST_FRAMEWORK
@@ -22,6 +23,107 @@ const uint8_t _storagedata[(STORAGE_SIZE+255)/256*256] = { };
 #endif
 FlashClass storage(_storagedata, STORAGE_SIZE);
 
+// the magic number at the start of every block in the log
+#define BLOCK_MAGIC 0x474F4C56
+
+// the offset of a key that has no record
+#define OFFSET_NONE 0xFFFF
+
+// no block is waiting to be erased
+#define BLOCK_NONE 0xFF
+
+// flash is written a page at a time and erased a row at a time
+#define FLASH_PAGE_BYTES 64
+#define FLASH_ROW_BYTES 256
+#define ROWS_PER_BLOCK (STORAGE_BLOCK_SIZE / FLASH_ROW_BYTES)
+
+// every block starts with a header, the sequence number counts up by one
+// for each block the log moves into so the order of the blocks is known
+struct BlockHeader
+{
+  uint32_t magic;
+  uint32_t seq;
+};
+
+// every record starts with a header followed by size bytes of data which
+// is padded out to a multiple of 4 bytes, a record with no data means the
+// key was removed and a header that is all 0xFF is the end of the block
+struct RecordHeader
+{
+  uint8_t key;
+  uint8_t reserved;
+  uint16_t size;
+  uint32_t hash;
+};
+
+// the size in flash of a record with the given size of data
+static inline uint32_t recordSize(uint32_t size)
+{
+  return sizeof(RecordHeader) + ((size + 3) & ~3);
+}
+
+// hash a record the same way the serial buffer hashes its data
+static uint32_t recordHash(uint8_t key, const uint8_t *data, uint32_t size)
+{
+  uint32_t hash = 5381;
+  hash = ((hash << 5) + hash) + key;
+  hash = ((hash << 5) + hash) + size;
+  for (uint32_t i = 0; i < size; ++i) {
+    hash = ((hash << 5) + hash) + data[i];
+  }
+  return hash;
+}
+
+static inline const uint8_t *blockData(uint32_t block)
+{
+  return (const uint8_t *)_storagedata + (block * STORAGE_BLOCK_SIZE);
+}
+
+static inline const BlockHeader *blockHeader(uint32_t block)
+{
+  return (const BlockHeader *)blockData(block);
+}
+
+// the flash library loads a page worth of words counting from the pointer
+// it's given then writes one page, so every write is split up at the end
+// of each page or the words past it would land in the wrong page
+static void writeFlash(const uint8_t *dst, const void *data, uint32_t size)
+{
+  const uint8_t *src = (const uint8_t *)data;
+  while (size) {
+    uint32_t amount = FLASH_PAGE_BYTES - ((dst - _storagedata) % FLASH_PAGE_BYTES);
+    if (amount > size) {
+      amount = size;
+    }
+    storage.write(dst, src, amount);
+    dst += amount;
+    src += amount;
+    size -= amount;
+  }
+}
+
+static bool blockErased(uint32_t block)
+{
+  const uint32_t *words = (const uint32_t *)blockData(block);
+  for (uint32_t i = 0; i < STORAGE_BLOCK_SIZE / sizeof(uint32_t); ++i) {
+    if (words[i] != 0xFFFFFFFF) {
+      return false;
+    }
+  }
+  return true;
+}
+
+uint16_t Storage::m_offsets[STORAGE_MAX_KEYS];
+uint8_t Storage::m_tail = 0;
+uint8_t Storage::m_head = 0;
+uint8_t Storage::m_usedBlocks = 0;
+uint16_t Storage::m_headPos = 0;
+uint32_t Storage::m_seq = 0;
+uint8_t Storage::m_eraseBlock = BLOCK_NONE;
+uint8_t Storage::m_eraseRow = 0;
+uint32_t Storage::m_bytesWritten = 0;
+uint32_t Storage::m_blockErases = 0;
+
 Storage::Storage()
 {
 }
@@ -33,6 +135,10 @@ bool Storage::init()
   DeleteFile("FlashStorage.flash");
 #endif
 #endif
+  m_bytesWritten = 0;
+  m_blockErases = 0;
+  scan();
+  DEBUG_LOGF("Storage log is using %u of %u blocks", m_usedBlocks, STORAGE_NUM_BLOCKS);
   return true;
 }
 
@@ -40,43 +146,333 @@ void Storage::cleanup()
 {
 }
 
-// store a serial buffer to storage
-bool Storage::write(SerialBuffer &buffer)
+// store a serial buffer under a key
+bool Storage::write(uint8_t key, const SerialBuffer &buffer)
 {
-  if (buffer.size() > STORAGE_SIZE) {
-    ERROR_LOG("Buffer too big");
+  if (key >= STORAGE_MAX_KEYS) {
+    ERROR_LOG("Invalid storage key");
     return false;
   }
-  if (!buffer.compress()) {
+  SerialBuffer record(buffer);
+  if (!record.compress()) {
     // don't write if we can't compress
     ERROR_LOG("Did not compress storage");
     return false;
   }
-  storage.erase();
-  storage.write(_storagedata, buffer.rawData(), buffer.rawSize());
-  DEBUG_LOGF("Wrote %u bytes to storage (max: %u)", buffer.size(), STORAGE_SIZE);
+  const uint8_t *data = (const uint8_t *)record.rawData();
+  uint32_t size = record.rawSize();
+  if (exists(key)) {
+    // skip the write if the same record is already stored
+    const RecordHeader *header = (const RecordHeader *)(_storagedata + m_offsets[key]);
+    if (header->size == size && memcmp(header + 1, data, size) == 0) {
+      return true;
+    }
+  }
+  if (!append(key, data, size)) {
+    return false;
+  }
+  DEBUG_LOGF("Wrote %u bytes to storage key %u", size, key);
   return true;
 }
 
 // read a serial buffer from storage
-bool Storage::read(SerialBuffer &buffer)
+bool Storage::read(uint8_t key, SerialBuffer &buffer)
 {
-  if (!buffer.init(STORAGE_SIZE)) {
+  SerialBufferView view;
+  if (!Storage::view(key, view)) {
     return false;
   }
-  storage.read(buffer.rawData());
-  if (!buffer.size()) {
-    DEBUG_LOG("Read null from storage");
+  if (!buffer.decompress(view)) {
+    DEBUG_LOG("Failed to decompress buffer loaded from storage");
     return false;
   }
-  if (!buffer.decompress()) {
-    DEBUG_LOG("Failed to decompress buffer loaded from storage");
+  return true;
+}
+
+// view a serial buffer in storage without copying it
+bool Storage::view(uint8_t key, SerialBufferView &view)
+{
+  if (!exists(key)) {
+    return false;
+  }
+  const RecordHeader *header = (const RecordHeader *)(_storagedata + m_offsets[key]);
+  return view.rawInit((const uint8_t *)(header + 1), header->size);
+}
+
+bool Storage::remove(uint8_t key)
+{
+  if (!exists(key)) {
+    return true;
+  }
+  return append(key, nullptr, 0);
+}
+
+bool Storage::exists(uint8_t key)
+{
+  return key < STORAGE_MAX_KEYS && m_offsets[key] != OFFSET_NONE;
+}
+
+// the older firmware erased the whole storage and wrote one raw serial
+// buffer at the start of it, the log starts in the blocks after it so it
+// is still there until the log wraps around, after that the size or the
+// crc won't match anymore
+bool Storage::readLegacy(SerialBuffer &buffer)
+{
+  uint32_t size = 0;
+  memcpy(&size, _storagedata, sizeof(size));
+  if (!size || size > (STORAGE_SIZE - sizeof(SerialBuffer::RawBuffer))) {
+    return false;
+  }
+  SerialBufferView view;
+  if (!view.rawInit(_storagedata, size + sizeof(SerialBuffer::RawBuffer))) {
+    return false;
+  }
+  if (!buffer.decompress(view)) {
+    DEBUG_LOG("Failed to decompress legacy storage");
+    return false;
+  }
+  DEBUG_LOGF("Loaded %u bytes of legacy storage", buffer.size());
+  return true;
+}
+
+// the number of blocks covered by the buffer that older firmware wrote
+// at the start of the storage, the log starts after it so the old modes
+// can still be read if the power goes out before they are saved again
+uint32_t Storage::legacyBlocks()
+{
+  uint32_t size = 0;
+  memcpy(&size, _storagedata, sizeof(size));
+  if (!size || size > (STORAGE_SIZE - sizeof(SerialBuffer::RawBuffer))) {
+    return 0;
+  }
+  uint32_t blocks = (size + sizeof(SerialBuffer::RawBuffer) + STORAGE_BLOCK_SIZE - 1) / STORAGE_BLOCK_SIZE;
+  // if it covers everything there's nowhere else for the log to go
+  return (blocks < STORAGE_NUM_BLOCKS) ? blocks : 0;
+}
+
+void Storage::maintain()
+{
+  if (m_eraseBlock != BLOCK_NONE) {
+    // erasing a whole block stalls for several ms so the block freed by
+    // the last compaction is erased one row each call instead
+    eraseRow();
+    return;
+  }
+  if (!m_usedBlocks || (STORAGE_NUM_BLOCKS - m_usedBlocks) >= STORAGE_SPARE_BLOCKS) {
+    return;
+  }
+  if (liveBytes(m_tail) > (uint32_t)(STORAGE_BLOCK_SIZE - m_headPos)) {
+    // there's no room in the newest block for the records of the oldest
+    // one, move to a new block first and collect the tail next time
+    startBlock();
+    return;
+  }
+  collectTail();
+}
+
+bool Storage::append(uint8_t key, const uint8_t *data, uint32_t size)
+{
+  uint32_t total = recordSize(size);
+  if (total > STORAGE_BLOCK_SIZE - sizeof(BlockHeader)) {
+    ERROR_LOGF("Record too big: %u", size);
     return false;
   }
-  if (!buffer.shrink()) {
-    DEBUG_LOG("Failed to shrink buffer loaded from storage");
+  uint32_t attempts = 0;
+  while (!m_usedBlocks || (m_headPos + total) > STORAGE_BLOCK_SIZE) {
+    // each new block may compact the oldest one, if every block has
+    // been tried then the records just don't fit
+    if (++attempts > STORAGE_NUM_BLOCKS || !startBlock()) {
+      ERROR_LOG("Storage full");
+      return false;
+    }
+  }
+  return writeRecord(key, data, size);
+}
+
+// write a record at the end of the newest block, it must fit
+bool Storage::writeRecord(uint8_t key, const uint8_t *data, uint32_t size)
+{
+  uint32_t offset = (m_head * STORAGE_BLOCK_SIZE) + m_headPos;
+  const uint8_t *dst = _storagedata + offset;
+  RecordHeader header;
+  header.key = key;
+  header.reserved = 0xFF;
+  header.size = (uint16_t)size;
+  header.hash = recordHash(key, data, size);
+  writeFlash(dst, &header, sizeof(header));
+  // flash is written a word at a time so the last few bytes are padded
+  uint32_t aligned = size & ~3;
+  if (aligned) {
+    writeFlash(dst + sizeof(header), data, aligned);
+  }
+  if (size > aligned) {
+    uint8_t last[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+    memcpy(last, data + aligned, size - aligned);
+    writeFlash(dst + sizeof(header) + aligned, last, sizeof(last));
+  }
+  m_offsets[key] = size ? offset : OFFSET_NONE;
+  m_headPos += recordSize(size);
+  m_bytesWritten += recordSize(size);
+  return true;
+}
+
+bool Storage::startBlock()
+{
+  if (m_usedBlocks >= STORAGE_NUM_BLOCKS) {
     return false;
   }
-  DEBUG_LOGF("Loaded %u bytes from storage", buffer.size());
+  uint8_t block = m_usedBlocks ? (m_head + 1) % STORAGE_NUM_BLOCKS : m_tail;
+  // the rest of a block that is still being erased is needed right now
+  while (m_eraseBlock == block) {
+    eraseRow();
+  }
+  if (!blockErased(block)) {
+    eraseBlock(block);
+  }
+  BlockHeader header;
+  header.magic = BLOCK_MAGIC;
+  header.seq = ++m_seq;
+  writeFlash(blockData(block), &header, sizeof(header));
+  m_bytesWritten += sizeof(header);
+  if (!m_usedBlocks) {
+    m_tail = block;
+  }
+  m_head = block;
+  m_headPos = sizeof(header);
+  m_usedBlocks++;
+  if (m_usedBlocks == STORAGE_NUM_BLOCKS) {
+    // that was the last free block, the records in the oldest block
+    // always fit in the new empty one so it can be freed up again
+    return collectTail();
+  }
   return true;
 }
+
+bool Storage::collectTail()
+{
+  if (m_usedBlocks < 2 || liveBytes(m_tail) > (uint32_t)(STORAGE_BLOCK_SIZE - m_headPos)) {
+    return false;
+  }
+  uint8_t tail = m_tail;
+  for (uint32_t key = 0; key < STORAGE_MAX_KEYS; ++key) {
+    if (m_offsets[key] == OFFSET_NONE || (m_offsets[key] / STORAGE_BLOCK_SIZE) != tail) {
+      continue;
+    }
+    const RecordHeader *header = (const RecordHeader *)(_storagedata + m_offsets[key]);
+    writeRecord(key, (const uint8_t *)(header + 1), header->size);
+  }
+  // removed keys don't need to be carried over, anything older than
+  // the oldest block is already gone
+  m_tail = (tail + 1) % STORAGE_NUM_BLOCKS;
+  m_usedBlocks--;
+  // the first row holds the block header so erasing it drops the block
+  // out of the log right away, the rest is erased by maintain()
+  while (m_eraseBlock != BLOCK_NONE) {
+    eraseRow();
+  }
+  m_eraseBlock = tail;
+  m_eraseRow = 0;
+  eraseRow();
+  return true;
+}
+
+void Storage::eraseBlock(uint32_t block)
+{
+  storage.erase(blockData(block), STORAGE_BLOCK_SIZE);
+  m_blockErases++;
+}
+
+void Storage::eraseRow()
+{
+  if (m_eraseBlock == BLOCK_NONE) {
+    return;
+  }
+  storage.erase(blockData(m_eraseBlock) + (m_eraseRow * FLASH_ROW_BYTES), FLASH_ROW_BYTES);
+  if (++m_eraseRow < ROWS_PER_BLOCK) {
+    return;
+  }
+  m_eraseBlock = BLOCK_NONE;
+  m_eraseRow = 0;
+  m_blockErases++;
+}
+
+uint32_t Storage::liveBytes(uint32_t block)
+{
+  uint32_t total = 0;
+  for (uint32_t key = 0; key < STORAGE_MAX_KEYS; ++key) {
+    if (m_offsets[key] == OFFSET_NONE || (m_offsets[key] / STORAGE_BLOCK_SIZE) != block) {
+      continue;
+    }
+    total += recordSize(((const RecordHeader *)(_storagedata + m_offsets[key]))->size);
+  }
+  return total;
+}
+
+void Storage::scan()
+{
+  for (uint32_t key = 0; key < STORAGE_MAX_KEYS; ++key) {
+    m_offsets[key] = OFFSET_NONE;
+  }
+  m_tail = 0;
+  m_head = 0;
+  m_usedBlocks = 0;
+  m_headPos = STORAGE_BLOCK_SIZE;
+  m_seq = 0;
+  // a block that was part way through being erased has no header anymore
+  // so it is erased again when the log gets to it
+  m_eraseBlock = BLOCK_NONE;
+  m_eraseRow = 0;
+  // the newest block has the highest sequence number
+  for (uint32_t block = 0; block < STORAGE_NUM_BLOCKS; ++block) {
+    const BlockHeader *header = blockHeader(block);
+    if (header->magic != BLOCK_MAGIC) {
+      continue;
+    }
+    if (!m_usedBlocks || header->seq > m_seq) {
+      m_head = block;
+      m_seq = header->seq;
+      m_usedBlocks = 1;
+    }
+  }
+  if (!m_usedBlocks) {
+    // keep clear of anything older firmware left at the start
+    m_tail = legacyBlocks();
+    return;
+  }
+  // then walk back through the blocks before it that count down by one
+  m_tail = m_head;
+  while (m_usedBlocks < STORAGE_NUM_BLOCKS) {
+    uint8_t prev = (m_tail + STORAGE_NUM_BLOCKS - 1) % STORAGE_NUM_BLOCKS;
+    const BlockHeader *header = blockHeader(prev);
+    if (header->magic != BLOCK_MAGIC || header->seq != blockHeader(m_tail)->seq - 1) {
+      break;
+    }
+    m_tail = prev;
+    m_usedBlocks++;
+  }
+  // replay the records from oldest to newest, the last one of each key wins
+  for (uint32_t i = 0; i < m_usedBlocks; ++i) {
+    uint32_t block = (m_tail + i) % STORAGE_NUM_BLOCKS;
+    uint32_t pos = sizeof(BlockHeader);
+    while ((pos + sizeof(RecordHeader)) <= STORAGE_BLOCK_SIZE) {
+      const RecordHeader *header = (const RecordHeader *)(blockData(block) + pos);
+      if (header->key == 0xFF && header->size == 0xFFFF) {
+        // the rest of the block is empty
+        break;
+      }
+      if (header->key >= STORAGE_MAX_KEYS || recordSize(header->size) > (STORAGE_BLOCK_SIZE - pos) ||
+          header->hash != recordHash(header->key, (const uint8_t *)(header + 1), header->size)) {
+        // a write that didn't finish, nothing more goes in this block
+        ERROR_LOGF("Bad storage record in block %u at %u", block, pos);
+        pos = STORAGE_BLOCK_SIZE;
+        break;
+      }
+      uint32_t offset = (block * STORAGE_BLOCK_SIZE) + pos;
+      m_offsets[header->key] = header->size ? offset : OFFSET_NONE;
+      pos += recordSize(header->size);
+    }
+    if (block == m_head) {
+      m_headPos = pos;
+    }
+  }
+}
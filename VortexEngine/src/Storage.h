@@ -1,23 +1,105 @@
 #ifndef STORAGE_H
 #define STORAGE_H
 
+#include <inttypes.h>
+
 #define STORAGE_SIZE 8192
 
+// the storage is split into blocks which are erased one at a time, each
+// block is a whole number of flash rows and records never span two blocks
+#define STORAGE_BLOCK_SIZE 1024
+#define STORAGE_NUM_BLOCKS (STORAGE_SIZE / STORAGE_BLOCK_SIZE)
+
+// the number of erased blocks that maintain() tries to keep ahead of
+// the log so that a save rarely has to move records or erase anything
+#define STORAGE_SPARE_BLOCKS 2
+
+// the number of different keys records can be stored under
+#define STORAGE_MAX_KEYS 64
+
 class SerialBuffer;
+class SerialBufferView;
 
+// Log structured storage of records in flash
+//
+// Instead of erasing the whole storage and writing everything each save
+// every record is appended to the end of a log which rotates through all
+// of the blocks, so each save only writes the records that changed and
+// the erases are spread evenly over the flash. When the log runs low on
+// free blocks the oldest block is compacted by copying the records in it
+// that are still current to the end of the log then erasing it
 class Storage
 {
   Storage();
 public:
 
-  // init storage
+  // init storage, this scans the log to find the latest records
   static bool init();
   static void cleanup();
 
-  // store a serial buffer to storage
-  static bool write(SerialBuffer &buffer);
-  // read a serial buffer from storage
-  static bool read(SerialBuffer &buffer);
+  // store a serial buffer under a key, nothing is written if the
+  // stored record is already the same
+  static bool write(uint8_t key, const SerialBuffer &buffer);
+  // read the serial buffer stored under a key
+  static bool read(uint8_t key, SerialBuffer &buffer);
+  // point a view at the serial buffer stored under a key, the data is
+  // used straight out of the flash so it may still be compressed and
+  // the view is only good until the storage changes
+  static bool view(uint8_t key, SerialBufferView &view);
+  // remove the record stored under a key
+  static bool remove(uint8_t key);
+  // whether anything is stored under a key
+  static bool exists(uint8_t key);
+
+  // read the single buffer that older firmware stored across the whole
+  // storage, this works until the log wraps around over it
+  static bool readLegacy(SerialBuffer &buffer);
+
+  // compact the oldest block if there aren't enough free blocks, this
+  // copies at most one block of records or erases one row each call so
+  // it can run every tick
+  static void maintain();
+
+  // the number of blocks the log is using and the total bytes written
+  // to the flash and blocks erased since init
+  static uint32_t usedBlocks() { return m_usedBlocks; }
+  static uint32_t bytesWritten() { return m_bytesWritten; }
+  static uint32_t blockErases() { return m_blockErases; }
+
+private:
+  // append a record to the end of the log
+  static bool append(uint8_t key, const uint8_t *data, uint32_t size);
+  static bool writeRecord(uint8_t key, const uint8_t *data, uint32_t size);
+  // start writing to the next block of the log
+  static bool startBlock();
+  // move the current records out of the oldest block then erase it
+  static bool collectTail();
+  static void eraseBlock(uint32_t block);
+  // erase the next row of the block that is waiting to be erased
+  static void eraseRow();
+  // the total size of the current records in a block
+  static uint32_t liveBytes(uint32_t block);
+  // read the log back from flash
+  static void scan();
+  // the number of blocks the buffer of older firmware covers
+  static uint32_t legacyBlocks();
+
+  // where the current record of each key starts
+  static uint16_t m_offsets[STORAGE_MAX_KEYS];
+  // the oldest and newest block of the log
+  static uint8_t m_tail;
+  static uint8_t m_head;
+  static uint8_t m_usedBlocks;
+  // where the next record goes in the newest block
+  static uint16_t m_headPos;
+  // the sequence number of the newest block
+  static uint32_t m_seq;
+  // the block freed by the last compaction and the next row of it to erase
+  static uint8_t m_eraseBlock;
+  static uint8_t m_eraseRow;
+
+  static uint32_t m_bytesWritten;
+  static uint32_t m_blockErases;
 };
 
 #endif
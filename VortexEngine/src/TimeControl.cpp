@@ -11,11 +11,25 @@
 // static members
 uint64_t Time::m_curTick = 0;
 uint64_t Time::m_prevTime = 0;
+uint32_t Time::m_wakeTime = 0;
+uint32_t Time::m_busyMicros = 0;
+uint32_t Time::m_idleMicros = 0;
+uint32_t Time::m_secondTicks = 0;
+uint32_t Time::m_maxFrameMicros = 0;
+uint32_t Time::m_overruns = 0;
+uint32_t Time::m_lastBusyMicros = 0;
+uint32_t Time::m_lastIdleMicros = 0;
+uint32_t Time::m_lastAvgFrameMicros = 0;
+uint32_t Time::m_lastMaxFrameMicros = 0;
+uint32_t Time::m_lastOverruns = 0;
+uint32_t Time::m_totalOverruns = 0;
+OverrunPolicy Time::m_overrunPolicy = DEFAULT_OVERRUN_POLICY;
 uint64_t Time::m_firstTime = 0;
 uint32_t Time::m_tickrate = DEFAULT_TICKRATE;
 uint32_t Time::m_tickOffset = DEFAULT_TICK_OFFSET;
 uint32_t Time::m_simulationTick = 0;
 bool Time::m_isSimulation = false;
+uint32_t Time::m_seekTicks = 0;
 
 #ifdef FIXED_TICKRATE
 #define TICKRATE DEFAULT_TICKRATE
@@ -25,7 +39,7 @@ bool Time::m_isSimulation = false;
 
 bool Time::init()
 {
-  m_firstTime = m_prevTime = micros();
+  m_firstTime = m_prevTime = m_wakeTime = micros();
   return true;
 }
 
@@ -46,25 +60,97 @@ void Time::tickClock()
   }
 #endif
 
-  // perform timestep
-  uint32_t elapsed_us;
-  uint32_t us;
-  do {
-    us = micros();
-    // detect rollover of microsecond counter
-    if (us < m_prevTime) {
-      // calculate wrapped around difference
-      elapsed_us = (uint32_t)((UINT32_MAX - m_prevTime) + us);
-    } else {
-      // otherwise calculate regular difference
-      elapsed_us = (uint32_t)(us - m_prevTime);
+  // the time this tick started, everything since the last wakeup
+  // was spent working on the previous tick
+  uint32_t now = micros();
+  uint32_t frameTime = now - m_wakeTime;
+  m_busyMicros += frameTime;
+  if (frameTime > m_maxFrameMicros) {
+    m_maxFrameMicros = frameTime;
+  }
+
+  // 1000us per ms, divided by tickrate gives
+  // the number of microseconds per tick
+  uint32_t tickTime = 1000000 / TICKRATE;
+  if (frameTime > tickTime) {
+    // the previous tick did more work than fits in a tick
+    m_overruns++;
+    m_totalOverruns++;
+  }
+
+  uint32_t deadline = (uint32_t)m_prevTime + tickTime;
+  if ((int32_t)(deadline - now) > 0) {
+    // sleep away the rest of the tick
+    idleUntil(deadline);
+  } else {
+    // this tick is already late, how far behind the grid are we
+    uint32_t behind = now - deadline;
+    switch (m_overrunPolicy) {
+    case OVERRUN_CATCHUP:
+      // leave the deadline on the grid so the next ticks run back to
+      // back, unless so far behind that catching up would take forever
+      if (behind >= (MAX_CATCHUP_TICKS * tickTime)) {
+        deadline = now;
+      }
+      break;
+    case OVERRUN_DROP:
+      // skip over the ticks that were missed entirely, patterns will
+      // see the tick counter jump forward to match the wall time
+      m_curTick += behind / tickTime;
+      deadline += (behind / tickTime) * tickTime;
+      break;
+    case OVERRUN_STRETCH:
+    default:
+      // this tick starts right away and everything after shifts back
+      deadline = now;
+      break;
     }
-    // 1000us per ms, divided by tickrate gives
-    // the number of microseconds per tick
-  } while (elapsed_us < (1000000 / TICKRATE));
+  }
+
+  // store current time, the deadline is used instead of the wakeup
+  // time so that ticks stay on a fixed grid and don't slowly drift
+  m_prevTime = deadline;
+  m_wakeTime = micros();
+  m_idleMicros += m_wakeTime - now;
 
-  // store current time
-  m_prevTime = micros();
+  // publish the frame counters once per second of ticks
+  if (++m_secondTicks >= TICKRATE) {
+    m_lastBusyMicros = m_busyMicros;
+    m_lastIdleMicros = m_idleMicros;
+    m_lastAvgFrameMicros = m_busyMicros / m_secondTicks;
+    m_lastMaxFrameMicros = m_maxFrameMicros;
+    m_lastOverruns = m_overruns;
+    if (m_overruns) {
+      DEBUG_LOGF("Tick overruns: %u (%u total) frame avg: %uus max: %uus",
+        m_overruns, m_totalOverruns, m_lastAvgFrameMicros, m_maxFrameMicros);
+    }
+    m_busyMicros = 0;
+    m_idleMicros = 0;
+    m_maxFrameMicros = 0;
+    m_overruns = 0;
+    m_secondTicks = 0;
+  }
+}
+
+void Time::idleUntil(uint32_t deadline)
+{
+  uint32_t now;
+  // the subtraction handles rollover of the microsecond counter
+  while ((int32_t)(deadline - (now = micros())) > 0) {
+#ifdef TEST_FRAMEWORK
+    // the test framework decides how to wait, the linux framework
+    // either advances the virtual clock or nanosleeps
+    delayMicroseconds(deadline - now);
+#else
+    // the systick interrupt fires every millisecond and wakes the cpu
+    // from WFI, only sleep if it will fire before the deadline otherwise
+    // just spin out the last few microseconds
+    uint32_t usToSysTick = SysTick->VAL / (F_CPU / 1000000);
+    if (usToSysTick <= (deadline - now)) {
+      __WFI();
+    }
+#endif
+  }
 }
 
 // get the current time with optional led position time offset
@@ -162,3 +248,28 @@ uint32_t Time::endSimulation()
   return endTick;
 }
 
+void Time::startSeek(uint32_t ticks)
+{
+  // finish any seek that is already running first
+  endSeek();
+  // this may wrap if the clock hasn't run that long yet, timers and
+  // patterns only ever look at the difference between two ticks
+  m_curTick -= ticks;
+  m_seekTicks = ticks;
+}
+
+void Time::tickSeek()
+{
+  if (!m_seekTicks) {
+    return;
+  }
+  m_curTick++;
+  m_seekTicks--;
+}
+
+void Time::endSeek()
+{
+  m_curTick += m_seekTicks;
+  m_seekTicks = 0;
+}
+
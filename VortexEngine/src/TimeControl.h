@@ -5,6 +5,17 @@
 
 #include "LedTypes.h"
 
+// How the timestep reacts when a tick takes longer than the tickrate allows
+enum OverrunPolicy : uint8_t
+{
+  // start the next tick late and let the pattern timeline stretch
+  OVERRUN_STRETCH,
+  // stay on the tick grid and run ticks back to back until caught up
+  OVERRUN_CATCHUP,
+  // skip the missed ticks so the pattern timeline follows wall time
+  OVERRUN_DROP,
+};
+
 class Time
 {
   // private unimplemented constructor
@@ -19,6 +30,23 @@ public:
   // tick the clock forward to millis()
   static void tickClock();
 
+  // the microseconds spent working and sleeping during the last full
+  // second of ticks, busy + idle is roughly one second of time
+  static uint32_t busyMicros() { return m_lastBusyMicros; }
+  static uint32_t idleMicros() { return m_lastIdleMicros; }
+
+  // the average and longest tick durations of the last full second
+  static uint32_t avgFrameMicros() { return m_lastAvgFrameMicros; }
+  static uint32_t maxFrameMicros() { return m_lastMaxFrameMicros; }
+
+  // the number of ticks that overran in the last full second, and in total
+  static uint32_t overruns() { return m_lastOverruns; }
+  static uint32_t totalOverruns() { return m_totalOverruns; }
+
+  // change how the timestep reacts to ticks that overrun
+  static void setOverrunPolicy(OverrunPolicy policy) { m_overrunPolicy = policy; }
+  static OverrunPolicy getOverrunPolicy() { return m_overrunPolicy; }
+
   // get the current time with optional led position time offset
   static uint64_t getCurtime(LedPos pos = LED_FIRST);
 
@@ -72,13 +100,56 @@ public:
   // Finish a time simulation
   static uint32_t endSimulation();
 
+  // Start a seek, this winds the current time back by some ticks so that
+  // patterns can be initialized in the past then played up to the present
+  // with tickSeek(), unlike a simulation any changes the patterns make to
+  // their timers are kept so they carry on from there when the seek ends.
+  // endSeek() puts the current time back no matter how far it got
+  static void startSeek(uint32_t ticks);
+
+  // Tick a seek forward towards the present
+  static void tickSeek();
+
+  // Finish a seek
+  static void endSeek();
+
 private:
+  // sleep until the given microsecond deadline
+  static void idleUntil(uint32_t deadline);
+
   // global tick counter
   static uint64_t m_curTick;
 
-  // the last frame timestamp
+  // the scheduled start time of the current tick
   static uint64_t m_prevTime;
 
+  // the time the current tick actually woke up
+  static uint32_t m_wakeTime;
+
+  // busy/idle microseconds accumulated in the current second
+  static uint32_t m_busyMicros;
+  static uint32_t m_idleMicros;
+  // the ticks counted towards the current second
+  static uint32_t m_secondTicks;
+
+  // the longest tick and number of overruns in the current second
+  static uint32_t m_maxFrameMicros;
+  static uint32_t m_overruns;
+
+  // busy/idle microseconds of the last full second
+  static uint32_t m_lastBusyMicros;
+  static uint32_t m_lastIdleMicros;
+  // frame times and overruns of the last full second
+  static uint32_t m_lastAvgFrameMicros;
+  static uint32_t m_lastMaxFrameMicros;
+  static uint32_t m_lastOverruns;
+
+  // the total number of overruns
+  static uint32_t m_totalOverruns;
+
+  // how overruns are handled
+  static OverrunPolicy m_overrunPolicy;
+
   // the first timestamp
   static uint64_t m_firstTime;
 
@@ -96,6 +167,9 @@ private:
 
   // whether the timer is running a simulation
   static bool m_isSimulation;
+
+  // the number of ticks a seek is behind the present
+  static uint32_t m_seekTicks;
 };
 
 #endif
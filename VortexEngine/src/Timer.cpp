@@ -4,9 +4,22 @@
 #include "Memory.h"
 #include "Log.h"
 
+// the max number of alarms a timer can have, alarm ids must fit in an AlarmID
+#define MAX_ALARMS 127
+
+// the number of alarms a heap timer starts with
+#define MIN_HEAP_ALARMS 4
+
 Timer::Timer() :
-  m_alarms(nullptr),
+  Timer(nullptr, 0)
+{
+}
+
+Timer::Timer(uint32_t *storage, uint8_t capacity) :
+  m_alarms(storage),
   m_numAlarms(0),
+  m_capacity(capacity),
+  m_inlineAlarms(storage),
   m_curAlarm(0),
   m_startTime(0),
   m_simStartTime(0)
@@ -15,22 +28,59 @@ Timer::Timer() :
 
 Timer::~Timer()
 {
-  if (m_alarms) {
+  if (m_alarms && m_alarms != m_inlineAlarms) {
     vfree(m_alarms);
-    m_alarms = nullptr;
   }
+  m_alarms = nullptr;
 }
 
 AlarmID Timer::addAlarm(uint32_t interval)
 {
-  void *temp = vrealloc(m_alarms, sizeof(uint32_t) * (m_numAlarms + 1));
+  if (m_numAlarms >= m_capacity) {
+    // double the space each time it runs out
+    uint32_t newCapacity = m_capacity * 2;
+    if (newCapacity < MIN_HEAP_ALARMS) {
+      newCapacity = MIN_HEAP_ALARMS;
+    }
+    if (newCapacity > MAX_ALARMS) {
+      newCapacity = MAX_ALARMS;
+    }
+    if (!reserve(newCapacity)) {
+      return ALARM_NONE;
+    }
+  }
+  m_alarms[m_numAlarms] = interval;
+  return m_numAlarms++;
+}
+
+bool Timer::reserve(uint32_t numAlarms)
+{
+  if (numAlarms <= m_capacity) {
+    return true;
+  }
+  if (numAlarms > MAX_ALARMS) {
+    ERROR_LOGF("Too many alarms: %u", numAlarms);
+    return false;
+  }
+  uint32_t *temp = nullptr;
+  if (m_alarms == m_inlineAlarms) {
+    // move out of the inline storage and onto the heap
+    temp = (uint32_t *)vmalloc(sizeof(uint32_t) * numAlarms);
+    if (temp) {
+      for (uint32_t i = 0; i < m_numAlarms; ++i) {
+        temp[i] = m_alarms[i];
+      }
+    }
+  } else {
+    temp = (uint32_t *)vrealloc(m_alarms, sizeof(uint32_t) * numAlarms);
+  }
   if (!temp) {
     ERROR_OUT_OF_MEMORY();
     return false;
   }
-  m_alarms = (uint32_t *)temp;
-  m_alarms[m_numAlarms] = interval;
-  return m_numAlarms++;
+  m_alarms = temp;
+  m_capacity = numAlarms;
+  return true;
 }
 
 void Timer::restart(uint32_t offset)
@@ -48,8 +98,6 @@ void Timer::start(uint32_t offset)
 
 void Timer::reset()
 {
-  vfree(m_alarms);
-  m_alarms = nullptr;
   m_numAlarms = 0;
   m_curAlarm = 0;
   m_startTime = 0;
@@ -74,18 +122,12 @@ bool Timer::onEnd() const
   if (alarmTime <= 1) {
     return true;
   }
-  // grab curTime
-  uint64_t now = Time::getCurtime();
-  // get the start time of the timer
-  uint64_t startTime = getStartTime();
   // time since start (forward or backwards)
-  int32_t timeDiff = (int32_t)(int64_t)(now - startTime);
-  // if no time since start then this definitely isn't the end
-  if (!timeDiff) {
-    return false;
-  }
-  // check if timediff is multiple of last tick in alarm
-  return ((timeDiff % (alarmTime - 1)) == 0);
+  int32_t timeDiff = (int32_t)(int64_t)(Time::getCurtime() - getStartTime());
+  // if no time since start then this definitely isn't the end, otherwise
+  // the end is the last tick before the alarm triggers at start + alarmTime
+  // and the alarm resets the start so there is no need to check multiples
+  return (timeDiff > 0) && ((uint32_t)timeDiff >= (alarmTime - 1));
 }
 
 AlarmID Timer::alarm()
@@ -103,16 +145,19 @@ AlarmID Timer::alarm()
   if (timeDiff == 0) {
     return 0;
   }
-  uint32_t alarmTime = m_alarms[m_curAlarm];
-  // if the current alarm duration is not a multiple of the current tick
-  if (alarmTime && (timeDiff % alarmTime) != 0) {
-    // then the alarm was not hit
+  // the alarm triggers once its duration has passed since the start, this
+  // is a compare against the next alarm tick rather than checking whether
+  // the time passed is a multiple of the duration which needs a division
+  if ((uint32_t)timeDiff < m_alarms[m_curAlarm]) {
     return ALARM_NONE;
   }
   // update the start time of the timer
   setStartTime(now);
   // increment current alarm then return that id
-  m_curAlarm = (AlarmID)((m_curAlarm + 1) % m_numAlarms);
+  m_curAlarm++;
+  if (m_curAlarm >= m_numAlarms) {
+    m_curAlarm = 0;
+  }
   return m_curAlarm;
 }
 
@@ -10,6 +10,9 @@
 // an alarm id is just an int
 typedef int8_t AlarmID;
 
+// A timer keeps a list of alarm intervals and cycles through them, the
+// plain Timer keeps the list on the heap while an InlineTimer keeps the
+// first few alarms inside the timer itself (see below)
 class Timer
 {
 public:
@@ -20,6 +23,10 @@ public:
   // Alarm IDs start at 0 and count upward
   AlarmID addAlarm(uint32_t interval);
 
+  // make room for a number of alarms up front so that adding
+  // them one at a time doesn't need to grow the list each time
+  bool reserve(uint32_t numAlarms);
+
   // restart the timer entirely
   void restart(uint32_t offset = 0);
 
@@ -27,7 +34,8 @@ public:
   // the timer startTime but does not reset it's alarm state
   void start(uint32_t offset = 0);
 
-  // delete all alarms from the timer and reset
+  // delete all alarms from the timer and reset, the space for the
+  // alarms is kept so the timer can be refilled without allocating
   void reset();
 
   // returns true when the current timer is starting, used for synchronization
@@ -48,6 +56,10 @@ public:
   // the start time of the timer
   uint64_t startTime() const { return m_startTime; }
 
+protected:
+  // timers with inline storage hand it to the base timer
+  Timer(uint32_t *storage, uint8_t capacity);
+
 private:
   // helpers to set/get start time
   uint64_t getStartTime() const;
@@ -56,6 +68,10 @@ private:
   // the list of alarms and number of alarms
   uint32_t *m_alarms;
   uint8_t m_numAlarms;
+  // the number of alarms that fit in m_alarms
+  uint8_t m_capacity;
+  // inline storage of a derived InlineTimer, if any
+  uint32_t *m_inlineAlarms;
   // the current alarm being checked
   AlarmID m_curAlarm;
   // start time in microseconds
@@ -64,4 +80,18 @@ private:
   uint64_t m_simStartTime;
 };
 
+// A timer with room for CAPACITY alarms inside of itself, this is for the
+// patterns that always use the same couple alarms so that building their
+// timers never touches the heap. Going over the capacity still works, the
+// alarms just move to the heap like a regular Timer
+template<uint8_t CAPACITY>
+class InlineTimer : public Timer
+{
+public:
+  InlineTimer() : Timer(m_storage, CAPACITY), m_storage() {}
+
+private:
+  uint32_t m_storage[CAPACITY];
+};
+
 #endif
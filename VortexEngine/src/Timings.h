@@ -37,6 +37,24 @@
 // of sync with the previous finger
 #define DEFAULT_TICK_OFFSET 0
 
+// Tick Overrun Policy
+//
+// What to do when a tick takes longer than the tickrate allows:
+//
+//    OVERRUN_STRETCH   the next tick starts late and the pattern
+//                      timeline slowly drifts from wall time
+//    OVERRUN_CATCHUP   the next ticks run back to back without
+//                      sleeping until the timeline has caught up
+//    OVERRUN_DROP      the missed ticks are skipped and the tick
+//                      counter jumps forward to match wall time
+#define DEFAULT_OVERRUN_POLICY OVERRUN_STRETCH
+
+// Max Catchup Ticks
+//
+// With OVERRUN_CATCHUP, if the timeline falls this many ticks
+// behind then it gives up on catching up and starts fresh
+#define MAX_CATCHUP_TICKS 10
+
 // Fixed Tickrate
 //
 // Uncomment this to enable a fixed tickrate. That will
@@ -0,0 +1,20 @@
+#ifndef VORTEX_CONFIG_H
+#define VORTEX_CONFIG_H
+
+// Build settings that more than one part of the engine is sized from,
+// each can be defined ahead of time to override it
+
+// the number of instantiated modes that are kept around so that switching
+// back and forth doesn't have to rebuild them, this includes the current
+// mode and the next mode which is built ahead of time (set 1 to disable)
+#ifndef MODE_CACHE_SIZE
+#define MODE_CACHE_SIZE 3
+#endif
+
+// the cache only holds onto modes other than the current one while the
+// memory used by the heap and the pattern pool stays under this many bytes
+#ifndef MODE_CACHE_BUDGET
+#define MODE_CACHE_BUDGET 16384
+#endif
+
+#endif
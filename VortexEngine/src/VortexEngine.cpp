@@ -92,4 +92,8 @@ void VortexEngine::tick()
 
   // update the leds
   Leds::update();
+
+  // compact the storage after a save, this is done after the leds are
+  // updated so the time it takes to erase a row doesn't hold them up
+  Storage::maintain();
 }
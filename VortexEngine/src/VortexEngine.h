@@ -9,12 +9,12 @@
  *   - Randomize patterns?
  *   - Implement missing patterns
  *   - IR transmission protocol to allow any length data instead of single burst
- *   - Saving modes that have custom parameters won't work
+ *   - Saving modes that have custom parameters
  *      - conslusion:
- *          Will save parameters to serial, at risk of causing misalignments if people remove
- *          patterns or adjust the number of parameters a pattern takes. This is just part of
- *          the risk of editing the firmware.
- *          
+ *          Parameters are saved in a record with a length for each pattern (see Mode::serialize)
+ *          so patterns that gain or lose parameters still load, and a pattern that was removed
+ *          keeps its colorset on the first pattern. Bump MODE_VERSION if the format changes.
+ *
  *          Needs ir improvements first so that added data size can still be transmitted
  *
  *   - palm light?
@@ -1,6 +1,7 @@
 #include "ModeSharing.h"
 
 #include "../SerialBuffer.h"
+#include "../SerialBufferView.h"
 #include "../TimeControl.h"
 #include "../Infrared.h"
 #include "../Modes.h"
@@ -108,24 +109,32 @@ void ModeSharing::receiveMode()
 {
   //uint32_t val = 0;
   // lower 16 is the size of the data to follow
-  SerialBuffer buf;
+  SerialBufferView view;
   DEBUG_LOG("Receiving...");
   uint64_t startTime = micros();
-  if (!Infrared::read(buf)) {
-    // no mode to receive right now
-    //DEBUG_LOG("Failed to receive mode");
+  if (!Infrared::read(view)) {
+    // this is only called once a full message is ready so the message is
+    // bad, throw it away or nothing else will ever be received
+    DEBUG_LOG("Failed to receive mode");
+    Infrared::resetReceiver();
     return;
   }
   uint64_t endTime = micros();
-  DEBUG_LOGF("Received %u bytes (%u us)", buf.rawSize(), endTime - startTime);
-  // decompress and check crc at same time
-  if (!buf.decompress()) {
-    DEBUG_LOG("Failed to decompress, crc mismatch or bad data");
-    return;
+  DEBUG_LOGF("Received %u bytes (%u us)", view.size(), endTime - startTime);
+  // the mode is read straight out of the receive buffer unless it has
+  // to be decompressed first, the crc was checked by the view
+  SerialBuffer buf;
+  if (view.is_compressed()) {
+    if (!buf.decompress(view)) {
+      DEBUG_LOG("Failed to decompress, bad data");
+      Infrared::resetReceiver();
+      return;
+    }
+    view = SerialBufferView(buf);
   }
-  buf.resetUnserializer();
-  m_pCurMode->unserialize(buf);
+  m_pCurMode->unserialize(view);
   m_pCurMode->init();
+  Infrared::resetReceiver();
   DEBUG_LOG("Success receiving mode");
   leaveMenu();
 }
@@ -99,8 +99,14 @@ void PatternSelect::onShortClick()
 
 void PatternSelect::nextPattern()
 {
-  // increment to next pattern
-  m_newPatternID = (PatternID)((m_newPatternID + 1) % PATTERN_COUNT);
+  // increment to next pattern, skipping any that were compiled out,
+  // at least one pattern is always built in so this stops within a lap
+  for (uint32_t i = 0; i < PATTERN_COUNT; ++i) {
+    m_newPatternID = (PatternID)((m_newPatternID + 1) % PATTERN_COUNT);
+    if (PatternBuilder::isAvailable(m_newPatternID)) {
+      break;
+    }
+  }
   // change the pattern of demo mode
   m_pDemoMode->setPattern(m_newPatternID);
   m_pDemoMode->init();
@@ -2,7 +2,10 @@
 
 #include <Arduino.h>
 
+#include "../PatternBuilder.h"
+#include "../PatternPool.h"
 #include "../SerialBuffer.h"
+#include "../SerialBufferView.h"
 #include "../TimeControl.h"
 #include "../Colorset.h"
 #include "../Log.h"
@@ -19,6 +22,16 @@ Pattern::~Pattern()
 {
 }
 
+void *Pattern::operator new(size_t size)
+{
+  return PatternPool::alloc(size);
+}
+
+void Pattern::operator delete(void *ptr)
+{
+  PatternPool::release(ptr);
+}
+
 void Pattern::bind(const Colorset *set, LedPos pos)
 {
   if (!set) {
@@ -36,16 +49,47 @@ void Pattern::init()
   m_colorset.init();
 }
 
+RGBColor Pattern::evaluate(uint64_t tick, LedPos pos) const
+{
+  return RGB_OFF;
+}
+
+uint32_t Pattern::cycleTicks() const
+{
+  return 0;
+}
+
+void Pattern::seek(uint32_t targetTick)
+{
+  // a pattern that repeats only needs to replay part of the last cycle,
+  // everything else has to replay the whole way from the beginning. The
+  // flag is checked as well because patterns that can't be evaluated may
+  // inherit a cycle from a base class that no longer describes them
+  uint32_t cycle = hasFlags(PATTERN_FLAG_EVALUATE) ? cycleTicks() : 0;
+  uint32_t ticks = cycle ? (targetTick % cycle) : targetTick;
+  // initialize the pattern in the past then play it up to the present,
+  // the leds are only written to memory here and not shown
+  Time::startSeek(ticks);
+  init();
+  for (uint32_t i = 0; i < ticks; ++i) {
+    play();
+    Time::tickSeek();
+  }
+  Time::endSeek();
+}
+
 // must override the serialize routine to save the pattern
 void Pattern::serialize(SerialBuffer &buffer) const
 {
   //DEBUG_LOG("Serialize");
-  buffer.serialize((uint8_t)m_patternID);
+  // don't serialize the pattern ID, whoever stores the pattern writes
+  // it so the pattern builder knows which pattern to instantiate, the
+  // colorset always comes first so it can be read by any pattern
   m_colorset.serialize(buffer);
 }
 
 // must override unserialize to load patterns
-void Pattern::unserialize(SerialBuffer &buffer)
+void Pattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   // don't unserialize the pattern ID because it is already
@@ -54,6 +98,11 @@ void Pattern::unserialize(SerialBuffer &buffer)
   m_colorset.unserialize(buffer);
 }
 
+bool Pattern::hasDefaultParams(const uint8_t *params, uint32_t size) const
+{
+  return PatternBuilder::isDefaultParams(m_patternID, params, size);
+}
+
 bool Pattern::equals(const Pattern *other)
 {
   if (!other) {
@@ -5,6 +5,8 @@
 #include "../Patterns.h"
 #include "../Colorset.h"
 
+#include <stddef.h>
+
 // The heirarchy of pattern currently looks like this:
 /*
  *                                pattern*
@@ -22,8 +24,11 @@
 
 // the pattern is a multi-pattern
 #define PATTERN_FLAG_MULTI  (1<<0)
+// the pattern can compute its color at any tick with evaluate()
+#define PATTERN_FLAG_EVALUATE  (1<<1)
 
 class SerialBuffer;
+class SerialBufferView;
 
 class Pattern
 {
@@ -37,6 +42,10 @@ protected:
 public:
   virtual ~Pattern();
 
+  // all patterns are allocated from the PatternPool
+  static void *operator new(size_t size);
+  static void operator delete(void *ptr);
+
   // bind a colorset and position to the pattern and initialize
   virtual void bind(const Colorset *colorset, LedPos pos);
 
@@ -46,10 +55,29 @@ public:
   // pure virtual must override the play function
   virtual void play() = 0;
 
+  // the color the pattern shows on an led at a tick of Time::getCurtime()
+  // without playing it, this matches what play() would have shown if it
+  // was played every tick since init(). Only patterns with the flag
+  // PATTERN_FLAG_EVALUATE implement this, anything else is always off
+  virtual RGBColor evaluate(uint64_t tick, LedPos pos) const;
+
+  // the number of ticks after which the pattern repeats exactly, this is
+  // known for any pattern that can be evaluated, otherwise 0
+  virtual uint32_t cycleTicks() const;
+
+  // initialize the pattern and bring it to the given tick of its timeline,
+  // ie. where it would be if init() was called that many ticks ago
+  void seek(uint32_t targetTick);
+
   // must override the serialize routine to save the pattern
   virtual void serialize(SerialBuffer &buffer) const;
   // must override unserialize to load patterns
-  virtual void unserialize(SerialBuffer &buffer);
+  virtual void unserialize(SerialBufferView &buffer);
+
+  // whether the params are the ones the pattern is made with so only the
+  // colorset needs to be saved, the params are the bytes that serialize
+  // wrote after the colorset
+  virtual bool hasDefaultParams(const uint8_t *params, uint32_t size) const;
 
   // comparison to other pattern
   virtual bool equals(const Pattern *other);
@@ -1,6 +1,7 @@
 #include "HueShiftPattern.h"
 
 #include "../../SerialBuffer.h"
+#include "../../SerialBufferView.h"
 #include "../../TimeControl.h"
 #include "../../Leds.h"
 
@@ -41,7 +42,7 @@ void HueShiftPattern::serialize(SerialBuffer &buffer) const
   buffer.serialize(m_scale);
 }
 
-void HueShiftPattern::unserialize(SerialBuffer &buffer)
+void HueShiftPattern::unserialize(SerialBufferView &buffer)
 {
   MultiLedPattern::unserialize(buffer);
   buffer.unserialize(&m_speed);
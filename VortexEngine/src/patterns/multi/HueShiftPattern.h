@@ -17,7 +17,7 @@ public:
 
   // must override the serialize routine to save the pattern
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
 
 private:
   uint8_t m_speed;
@@ -4,6 +4,7 @@
 
 #include "../../PatternBuilder.h"
 #include "../../SerialBuffer.h"
+#include "../../SerialBufferView.h"
 #include "../../Colorset.h"
 #include "../../Log.h"
 
@@ -53,18 +54,18 @@ void HybridPattern::serialize(SerialBuffer &buffer) const
       DEBUG_LOG("Could not serialize hybrid pattern!");
       return;
     }
-    m_ledPatterns[pos]->serialize(buffer);
+    PatternBuilder::serialize(m_ledPatterns[pos], buffer);
   }
 }
 
 // must override unserialize to load patterns
-void HybridPattern::unserialize(SerialBuffer &buffer)
+void HybridPattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   clearPatterns();
   MultiLedPattern::unserialize(buffer);
   for (LedPos pos = LED_FIRST; pos <= LED_LAST; pos++) {
-    SingleLedPattern *pat = PatternBuilder::makeSingle((PatternID)buffer.unserialize8());
+    SingleLedPattern *pat = PatternBuilder::makeSingle(PatternBuilder::fromWireID(buffer.unserialize8()));
     if (!pat) {
       return;
     }
@@ -57,7 +57,7 @@ void RabbitPattern::serialize(SerialBuffer &buffer) const
 }
 
 // must override unserialize to load patterns
-void RabbitPattern::unserialize(SerialBuffer &buffer)
+void RabbitPattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   HybridPattern::unserialize(buffer);
@@ -18,7 +18,11 @@ public:
 
   // must override the serialize routine to save the pattern
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
+
+  // the sub patterns are the only params and init always makes them
+  // again from the colorset
+  virtual bool hasDefaultParams(const uint8_t *params, uint32_t size) const override { return true; }
 
 private:
 };
@@ -3,20 +3,30 @@
 #include "../single/SingleLedPattern.h"
 #include "../../PatternBuilder.h"
 #include "../../SerialBuffer.h"
+#include "../../SerialBufferView.h"
+#include "../../Memory.h"
 #include "../../Leds.h"
 #include "../../Log.h"
 
 #include <string.h>
 
+// the instance index of leds that have no pattern on a step
+#define INSTANCE_NONE 0xFF
+
 SequencedPattern::SequencedPattern(const Sequence &sequence) :
   HybridPattern(),
   m_sequence(sequence),
-  m_curSequence(0)
+  m_curSequence(0),
+  m_timer(),
+  m_instances(nullptr),
+  m_numInstances(0),
+  m_stepTables(nullptr)
 {
 }
 
 SequencedPattern::~SequencedPattern()
 {
+  clearInstances();
 }
 
 // init the pattern to initial state
@@ -29,49 +39,45 @@ void SequencedPattern::init()
   m_timer.reset();
 
   // create an alarm for each duration in the sequence
+  m_timer.reserve(m_sequence.numSteps());
   for (uint32_t i = 0; i < m_sequence.numSteps(); ++i) {
     m_timer.addAlarm(m_sequence[i].m_duration);
   }
 
+  if (!buildInstances()) {
+    // leave the pattern blank rather than half built
+    clearInstances();
+    ERROR_LOG("Failed to build sequenced pattern instances");
+  }
+
   m_timer.start();
 }
 
 // pure virtual must  the play function
 void SequencedPattern::play()
 {
+  if (!m_stepTables) {
+    return;
+  }
+  const uint8_t *prevTable = nullptr;
   if (m_timer.alarm() != -1 && !m_timer.onStart()) {
+    prevTable = m_stepTables + (m_curSequence * LED_COUNT);
     m_curSequence = (m_curSequence + 1) % m_sequence.numSteps();
   }
-  const SequenceStep &step = m_sequence[m_curSequence];
+  const uint8_t *table = m_stepTables + (m_curSequence * LED_COUNT);
   for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
-    // the current initialized pattern for this LED
-    SingleLedPattern *curPat = m_ledPatterns[pos];
-    // the intended pattern ID for this LED on this step
-    PatternID stepPattern = step.m_patternMap[pos];
-    // the actual colorset being used might be the pattern's colorset
-    const Colorset *curSet = &m_colorset;
-    if (step.m_colorsetMap[pos].numColors() > 0) {
-      // or it might be the steps' colorset if it's not empty
-      curSet = &step.m_colorsetMap[pos];
-    }
-    // if there's no pattern, or pattern is wrong colorset or pattern ID
-    if (!curPat || !curPat->getColorset()->equals(curSet) || curPat->getPatternID() != stepPattern) {
-      // delete any existing pattern and re-create it
-      delete m_ledPatterns[pos];
-      // create whichever pattern this step is (maybe PATTERN_NONE)
-      curPat = m_ledPatterns[pos] = PatternBuilder::makeSingle(stepPattern);
-      // if a pattern was created then bind and init it
-      if (curPat) {
-        curPat->bind(curSet, pos);
-        curPat->init();
-      }
-    }
-    // if there's no pattern set, or the intended pattern of this step is NONE
-    if (!curPat || stepPattern == PATTERN_NONE) {
+    uint8_t index = table[pos];
+    // if the intended pattern of this step is NONE
+    if (index == INSTANCE_NONE) {
       // clear the LED and don't play the pattern
       Leds::clearIndex(pos);
       continue;
     }
+    SingleLedPattern *curPat = m_instances[index];
+    // a led that switched to a different pattern starts it from the beginning
+    if (prevTable && prevTable[pos] != index) {
+      curPat->init();
+    }
     // otherwise play the pattern on this index
     curPat->play();
   }
@@ -87,9 +93,114 @@ void SequencedPattern::serialize(SerialBuffer &buffer) const
   m_sequence.serialize(buffer);
 }
 
-void SequencedPattern::unserialize(SerialBuffer &buffer)
+void SequencedPattern::unserialize(SerialBufferView &buffer)
 {
   // Note: intentionally skipping HybridPattern::unserialize
   MultiLedPattern::unserialize(buffer);
   m_sequence.unserialize(buffer);
 }
+
+bool SequencedPattern::buildInstances()
+{
+  clearInstances();
+  uint32_t numSteps = m_sequence.numSteps();
+  if (!numSteps) {
+    return true;
+  }
+  m_stepTables = (uint8_t *)vmalloc(numSteps * LED_COUNT);
+  if (!m_stepTables) {
+    ERROR_OUT_OF_MEMORY();
+    return false;
+  }
+  // number each distinct pattern and colorset of a led in the order they
+  // first appear, a led that repeats a pattern from an earlier step shares
+  // the same instance so it only needs to be compared here and not each tick
+  uint32_t numInstances = 0;
+  for (uint32_t i = 0; i < numSteps; ++i) {
+    const SequenceStep &step = m_sequence[i];
+    uint8_t *table = m_stepTables + (i * LED_COUNT);
+    for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
+      table[pos] = INSTANCE_NONE;
+      PatternID stepPattern = step.m_patternMap[pos];
+      if (stepPattern == PATTERN_NONE) {
+        continue;
+      }
+      const Colorset *stepSet = stepColorset(step, pos);
+      for (uint32_t j = 0; j < i; ++j) {
+        const SequenceStep &prev = m_sequence[j];
+        if (prev.m_patternMap[pos] == stepPattern && stepColorset(prev, pos)->equals(stepSet)) {
+          table[pos] = m_stepTables[(j * LED_COUNT) + pos];
+          break;
+        }
+      }
+      if (table[pos] != INSTANCE_NONE) {
+        continue;
+      }
+      if (numInstances >= INSTANCE_NONE) {
+        ERROR_LOG("Too many patterns in sequence");
+        return false;
+      }
+      table[pos] = (uint8_t)numInstances++;
+    }
+  }
+  if (!numInstances) {
+    return true;
+  }
+  m_instances = (SingleLedPattern **)vcalloc(sizeof(SingleLedPattern *), numInstances);
+  if (!m_instances) {
+    ERROR_OUT_OF_MEMORY();
+    return false;
+  }
+  m_numInstances = (uint8_t)numInstances;
+  // then build each instance from the step it first appears in
+  for (uint32_t i = 0; i < numSteps; ++i) {
+    const SequenceStep &step = m_sequence[i];
+    const uint8_t *table = m_stepTables + (i * LED_COUNT);
+    for (LedPos pos = LED_FIRST; pos < LED_COUNT; ++pos) {
+      uint8_t index = table[pos];
+      if (index == INSTANCE_NONE || m_instances[index]) {
+        continue;
+      }
+      SingleLedPattern *pat = PatternBuilder::makeSingle(step.m_patternMap[pos]);
+      if (!pat) {
+        // any steps using this instance are cleared below
+        continue;
+      }
+      pat->bind(stepColorset(step, pos), pos);
+      pat->init();
+      m_instances[index] = pat;
+    }
+  }
+  // any steps that point at an instance which failed to build leave the led blank
+  for (uint32_t i = 0; i < numSteps * LED_COUNT; ++i) {
+    if (m_stepTables[i] != INSTANCE_NONE && !m_instances[m_stepTables[i]]) {
+      m_stepTables[i] = INSTANCE_NONE;
+    }
+  }
+  return true;
+}
+
+void SequencedPattern::clearInstances()
+{
+  if (m_instances) {
+    for (uint32_t i = 0; i < m_numInstances; ++i) {
+      delete m_instances[i];
+    }
+    vfree(m_instances);
+    m_instances = nullptr;
+  }
+  m_numInstances = 0;
+  if (m_stepTables) {
+    vfree(m_stepTables);
+    m_stepTables = nullptr;
+  }
+}
+
+const Colorset *SequencedPattern::stepColorset(const SequenceStep &step, LedPos pos) const
+{
+  // the step's colorset if it's not empty, otherwise the pattern's colorset
+  if (step.m_colorsetMap[pos].numColors() > 0) {
+    return &step.m_colorsetMap[pos];
+  }
+  return &m_colorset;
+}
@@ -8,6 +8,7 @@
 #include "../../Timer.h"
 
 class SerialBuffer;
+class SerialBufferView;
 
 class SequencedPattern : public HybridPattern
 {
@@ -25,15 +26,30 @@ public:
 
   // must override the serialize routine to save the pattern
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
 
 protected:
+  // build an instance for each distinct pattern and colorset that each led
+  // uses across the sequence and the tables to look them up for each step
+  bool buildInstances();
+  void clearInstances();
+
+  // the colorset a led uses on a step
+  const Colorset *stepColorset(const SequenceStep &step, LedPos pos) const;
+
   // static data
   Sequence m_sequence;
 
   // runtime data
   uint32_t m_curSequence;
   Timer m_timer;
+
+  // the sub-patterns built for the sequence, these replace the per-led
+  // patterns of the hybrid pattern which stay empty
+  SingleLedPattern **m_instances;
+  uint8_t m_numInstances;
+  // for each step the index of the instance each led plays
+  uint8_t *m_stepTables;
 };
 
 #endif
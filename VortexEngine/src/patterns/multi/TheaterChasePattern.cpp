@@ -44,7 +44,7 @@ void TheaterChasePattern::serialize(SerialBuffer &buffer) const
 }
 
 // must override unserialize to load patterns
-void TheaterChasePattern::unserialize(SerialBuffer &buffer)
+void TheaterChasePattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   MultiLedPattern::unserialize(buffer);
@@ -18,7 +18,7 @@ public:
 
   // must override the serialize routine to save the pattern
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
 
 private:
 
@@ -1,6 +1,7 @@
 #include "AdvancedPattern.h"
 
 #include "../../SerialBuffer.h"
+#include "../../SerialBufferView.h"
 #include "../../TimeControl.h"
 #include "../../Colorset.h"
 #include "../../Leds.h"
@@ -15,6 +16,8 @@ AdvancedPattern::AdvancedPattern(uint8_t onDuration, uint8_t offDuration, uint8_
   m_groupCounter(0),
   m_repeatCounter(repeatGroup)
 {
+  // the groups and repeats aren't covered by the basic evaluate
+  m_patternFlags &= ~PATTERN_FLAG_EVALUATE;
 }
 
 AdvancedPattern::~AdvancedPattern()
@@ -100,7 +103,7 @@ void AdvancedPattern::serialize(SerialBuffer &buffer) const
   buffer.serialize(m_repeatGroup);
 }
 
-void AdvancedPattern::unserialize(SerialBuffer &buffer)
+void AdvancedPattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   BasicPattern::unserialize(buffer);
@@ -17,7 +17,7 @@ public:
   virtual void play() override;
 
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
 
 protected:
   // override from basicpattern
@@ -1,6 +1,7 @@
 #include "BasicPattern.h"
 
 #include "../../SerialBuffer.h"
+#include "../../SerialBufferView.h"
 #include "../../TimeControl.h"
 #include "../../Colorset.h"
 #include "../../Leds.h"
@@ -15,6 +16,9 @@ BasicPattern::BasicPattern(uint8_t onDuration, uint8_t offDuration, uint8_t gapD
   m_gapTimer(),
   m_inGap(false)
 {
+  // derived classes change the blink callbacks so they need to
+  // clear this if they don't also provide their own evaluate
+  m_patternFlags |= PATTERN_FLAG_EVALUATE;
 }
 
 BasicPattern::~BasicPattern()
@@ -68,6 +72,56 @@ void BasicPattern::play()
   }
 }
 
+RGBColor BasicPattern::evaluate(uint64_t tick, LedPos pos) const
+{
+  int64_t elapsed = ticksSinceInit(tick, pos);
+  uint32_t numColors = m_colorset.numColors();
+  if (elapsed < 0 || !numColors) {
+    return RGB_OFF;
+  }
+  // an alarm can only trigger once per tick so a duration of 0 lasts 1 tick
+  uint32_t onTicks = m_onDuration ? m_onDuration : 1;
+  uint32_t offTicks = m_offDuration ? m_offDuration : 1;
+  uint32_t blinkTicks = onTicks + offTicks;
+  // the gap starts on the tick the last color blinks off and replaces the
+  // rest of that off duration, then the next round starts after the gap
+  uint32_t roundTicks = numColors * blinkTicks;
+  if (m_gapDuration > 0) {
+    roundTicks = ((numColors - 1) * blinkTicks) + onTicks + m_gapDuration + 1;
+  }
+  uint32_t roundTick = (uint32_t)(elapsed % roundTicks);
+  uint32_t index = roundTick / blinkTicks;
+  uint32_t blinkTick = roundTick - (index * blinkTicks);
+  if (index >= numColors) {
+    // in the gap after the last color
+    return RGB_OFF;
+  }
+  if (blinkTick < onTicks) {
+    return m_colorset.get(index);
+  }
+  // the first off tick only clears the led if there is an off duration
+  // and every tick after that on the last color is part of the gap
+  if (m_offDuration > 0 || blinkTick > onTicks) {
+    return RGB_OFF;
+  }
+  return m_colorset.get(index);
+}
+
+uint32_t BasicPattern::cycleTicks() const
+{
+  // a full round of the colors and the gap, see evaluate()
+  uint32_t numColors = m_colorset.numColors();
+  uint32_t onTicks = m_onDuration ? m_onDuration : 1;
+  uint32_t offTicks = m_offDuration ? m_offDuration : 1;
+  if (!numColors) {
+    return onTicks + offTicks;
+  }
+  if (m_gapDuration > 0) {
+    return ((numColors - 1) * (onTicks + offTicks)) + onTicks + m_gapDuration + 1;
+  }
+  return numColors * (onTicks + offTicks);
+}
+
 void BasicPattern::serialize(SerialBuffer &buffer) const
 {
   //DEBUG_LOG("Serialize");
@@ -77,7 +131,7 @@ void BasicPattern::serialize(SerialBuffer &buffer) const
   buffer.serialize(m_gapDuration);
 }
 
-void BasicPattern::unserialize(SerialBuffer &buffer)
+void BasicPattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   SingleLedPattern::unserialize(buffer);
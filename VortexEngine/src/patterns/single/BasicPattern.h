@@ -17,8 +17,11 @@ public:
 
   virtual void play() override;
 
+  virtual RGBColor evaluate(uint64_t tick, LedPos pos) const override;
+  virtual uint32_t cycleTicks() const override;
+
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
 
 protected:
   // callbacks for blinking on/off, can be overridden by derived classes
@@ -42,8 +45,8 @@ protected:
   uint8_t m_gapDuration;
 
   // the blink timer
-  Timer m_blinkTimer;
-  Timer m_gapTimer;
+  InlineTimer<2> m_blinkTimer;
+  InlineTimer<1> m_gapTimer;
   bool m_inGap;
 };
 
@@ -1,6 +1,7 @@
 #include "BlendPattern.h"
 
 #include "../../SerialBuffer.h"
+#include "../../SerialBufferView.h"
 #include "../../TimeControl.h"
 #include "../../Colorset.h"
 #include "../../Leds.h"
@@ -14,6 +15,8 @@ BlendPattern::BlendPattern(uint8_t onDuration, uint8_t offDuration, uint8_t blen
   m_cur(),
   m_next()
 {
+  // the blended colors aren't covered by the basic evaluate
+  m_patternFlags &= ~PATTERN_FLAG_EVALUATE;
 }
 
 BlendPattern::~BlendPattern()
@@ -41,7 +44,7 @@ void BlendPattern::serialize(SerialBuffer &buffer) const
   buffer.serialize(m_speed);
 }
 
-void BlendPattern::unserialize(SerialBuffer &buffer)
+void BlendPattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   BasicPattern::unserialize(buffer);
@@ -1,6 +1,7 @@
 #include "BracketsPattern.h"
 
 #include "../../SerialBuffer.h"
+#include "../../SerialBufferView.h"
 #include "../../Colorset.h"
 #include "../../Leds.h"
 #include "../../Log.h"
@@ -11,6 +12,7 @@ BracketsPattern::BracketsPattern(uint8_t bracketDuration, uint8_t midDuration, u
   m_midDuration(midDuration),
   m_offDuration(offDuration)
 {
+  m_patternFlags |= PATTERN_FLAG_EVALUATE;
 }
 
 BracketsPattern::~BracketsPattern()
@@ -58,6 +60,46 @@ void BracketsPattern::play()
   }
 }
 
+RGBColor BracketsPattern::evaluate(uint64_t tick, LedPos pos) const
+{
+  int64_t elapsed = ticksSinceInit(tick, pos);
+  uint32_t numColors = m_colorset.numColors();
+  if (elapsed < 0 || !numColors) {
+    return RGB_OFF;
+  }
+  // an alarm can only trigger once per tick so a duration of 0 lasts 1 tick
+  uint32_t bracketTicks = m_bracketDuration ? m_bracketDuration : 1;
+  uint32_t midTicks = m_midDuration ? m_midDuration : 1;
+  uint32_t offTicks = m_offDuration ? m_offDuration : 1;
+  uint32_t roundTicks = (bracketTicks * 2) + midTicks + offTicks;
+  // each round steps forward to the next color for the mid and then back
+  // for the second bracket, so every round starts one color further along
+  uint32_t round = (uint32_t)(elapsed / roundTicks);
+  uint32_t roundTick = (uint32_t)(elapsed % roundTicks);
+  if (roundTick < bracketTicks) {
+    return m_colorset.get(round % numColors);
+  }
+  roundTick -= bracketTicks;
+  if (roundTick < midTicks) {
+    return m_colorset.get((round + 1) % numColors);
+  }
+  roundTick -= midTicks;
+  if (roundTick < bracketTicks) {
+    return m_colorset.get(round % numColors);
+  }
+  return RGB_OFF;
+}
+
+uint32_t BracketsPattern::cycleTicks() const
+{
+  // every color starts one round, see evaluate()
+  uint32_t bracketTicks = m_bracketDuration ? m_bracketDuration : 1;
+  uint32_t midTicks = m_midDuration ? m_midDuration : 1;
+  uint32_t offTicks = m_offDuration ? m_offDuration : 1;
+  uint32_t numColors = m_colorset.numColors() ? m_colorset.numColors() : 1;
+  return ((bracketTicks * 2) + midTicks + offTicks) * numColors;
+}
+
 void BracketsPattern::serialize(SerialBuffer &buffer) const
 {
   //DEBUG_LOG("Serialize");
@@ -67,7 +109,7 @@ void BracketsPattern::serialize(SerialBuffer &buffer) const
   buffer.serialize(m_offDuration);
 }
 
-void BracketsPattern::unserialize(SerialBuffer &buffer)
+void BracketsPattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   SingleLedPattern::unserialize(buffer);
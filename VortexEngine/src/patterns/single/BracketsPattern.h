@@ -17,8 +17,11 @@ public:
 
   virtual void play() override;
 
+  virtual RGBColor evaluate(uint64_t tick, LedPos pos) const override;
+  virtual uint32_t cycleTicks() const override;
+
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
 
 protected:
   // the duration of the brackets
@@ -29,7 +32,7 @@ protected:
   uint8_t m_offDuration;
 
   // the blink timer
-  Timer m_blinkTimer;
+  InlineTimer<4> m_blinkTimer;
 };
 
 #endif
@@ -25,7 +25,7 @@ void ReciprocalBlendPattern::serialize(SerialBuffer &buffer) const
   BlendPattern::serialize(buffer);
 }
 
-void ReciprocalBlendPattern::unserialize(SerialBuffer &buffer)
+void ReciprocalBlendPattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   BlendPattern::unserialize(buffer);
@@ -14,7 +14,7 @@ public:
   virtual void init() override;
 
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
 
 protected:
   // only override the onBlinkOn so we can control the color it blinks
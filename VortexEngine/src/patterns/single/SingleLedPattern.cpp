@@ -3,7 +3,8 @@
 #include "../../TimeControl.h"
 
 SingleLedPattern::SingleLedPattern() :
-  Pattern()
+  Pattern(),
+  m_initTick(0)
 {
 }
 
@@ -14,6 +15,18 @@ SingleLedPattern::~SingleLedPattern()
 void SingleLedPattern::init()
 {
   Pattern::init();
+  m_initTick = Time::getCurtime();
+}
+
+int64_t SingleLedPattern::ticksSinceInit(uint64_t tick, LedPos pos) const
+{
+  // the difference is taken before comparing so that patterns initialized
+  // by a seek before the clock had run that many ticks still work
+  int64_t elapsed = (int64_t)(tick - m_initTick);
+  if (pos != m_ledPos || elapsed < 0) {
+    return -1;
+  }
+  return elapsed;
 }
 
 // NOTE: this isn't working correctly because of some issues, need to fix
@@ -18,8 +18,13 @@ public:
   // NOTE: This is not working properly at the moment
   virtual void skip(uint32_t ticks);
 
-private:
+protected:
+  // the number of ticks since the pattern was initialized, or -1 if
+  // the tick is before the init or the tick isn't for this pattern's led
+  int64_t ticksSinceInit(uint64_t tick, LedPos pos) const;
 
+  // the tick the pattern was initialized on
+  uint64_t m_initTick;
 };
 
 #endif
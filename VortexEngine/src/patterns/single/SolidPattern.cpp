@@ -1,11 +1,14 @@
 #include "SolidPattern.h"
 
 #include "../../SerialBuffer.h"
+#include "../../SerialBufferView.h"
 
 SolidPattern::SolidPattern(uint8_t colIndex, uint8_t onDuration, uint8_t offDuration, uint8_t gapDuration) :
   BasicPattern(onDuration, offDuration, gapDuration),
   m_colIndex(colIndex)
 {
+  // always blinks the same color so the basic evaluate doesn't apply
+  m_patternFlags &= ~PATTERN_FLAG_EVALUATE;
 }
 
 SolidPattern::~SolidPattern()
@@ -28,7 +31,7 @@ void SolidPattern::serialize(SerialBuffer &buffer) const
   buffer.serialize(m_colIndex);
 }
 
-void SolidPattern::unserialize(SerialBuffer &buffer)
+void SolidPattern::unserialize(SerialBufferView &buffer)
 {
   BasicPattern::unserialize(buffer);
   buffer.unserialize(&m_colIndex);
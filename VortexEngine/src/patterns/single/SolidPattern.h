@@ -14,7 +14,7 @@ public:
   virtual void play() override;
 
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
 
 protected:
   // callbacks for blinking on/off, can be overridden by derived classes
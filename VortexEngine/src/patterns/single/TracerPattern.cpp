@@ -1,6 +1,7 @@
 #include "TracerPattern.h"
 
 #include "../../SerialBuffer.h"
+#include "../../SerialBufferView.h"
 #include "../../TimeControl.h"
 #include "../../Colorset.h"
 #include "../../Leds.h"
@@ -12,6 +13,7 @@ TracerPattern::TracerPattern(uint8_t tracerLength, uint8_t dotLength) :
   m_blinkTimer(),
   m_dotColor(0)
 {
+  m_patternFlags |= PATTERN_FLAG_EVALUATE;
 }
 
 TracerPattern::~TracerPattern()
@@ -23,6 +25,9 @@ void TracerPattern::init()
   // run base pattern init logic
   SingleLedPattern::init();
 
+  // start the dots from the first color after the tracer color
+  m_dotColor = 0;
+
   // reset the blink timer entirely
   m_blinkTimer.reset();
 
@@ -53,6 +58,39 @@ void TracerPattern::play()
   }
 }
 
+RGBColor TracerPattern::evaluate(uint64_t tick, LedPos pos) const
+{
+  int64_t elapsed = ticksSinceInit(tick, pos);
+  if (elapsed < 0) {
+    return RGB_OFF;
+  }
+  // an alarm can only trigger once per tick so a duration of 0 lasts 1 tick
+  uint32_t tracerTicks = m_tracerDuration ? m_tracerDuration : 1;
+  uint32_t dotTicks = m_dotDuration ? m_dotDuration : 1;
+  uint32_t round = (uint32_t)(elapsed / (tracerTicks + dotTicks));
+  if ((uint32_t)(elapsed % (tracerTicks + dotTicks)) < tracerTicks) {
+    return m_colorset.get(0);
+  }
+  // each dot moves on to the next color, skipping the tracer color
+  uint32_t dotColor = 0;
+  if (m_colorset.numColors() > 1) {
+    dotColor = round % (m_colorset.numColors() - 1);
+  }
+  return m_colorset.get(1 + dotColor);
+}
+
+uint32_t TracerPattern::cycleTicks() const
+{
+  // every dot color gets one round, see evaluate()
+  uint32_t tracerTicks = m_tracerDuration ? m_tracerDuration : 1;
+  uint32_t dotTicks = m_dotDuration ? m_dotDuration : 1;
+  uint32_t numDots = 1;
+  if (m_colorset.numColors() > 1) {
+    numDots = m_colorset.numColors() - 1;
+  }
+  return (tracerTicks + dotTicks) * numDots;
+}
+
 // must override the serialize routine to save the pattern
 void TracerPattern::serialize(SerialBuffer &buffer) const
 {
@@ -63,7 +101,7 @@ void TracerPattern::serialize(SerialBuffer &buffer) const
 }
 
 // must override unserialize to load patterns
-void TracerPattern::unserialize(SerialBuffer &buffer)
+void TracerPattern::unserialize(SerialBufferView &buffer)
 {
   //DEBUG_LOG("Unserialize");
   SingleLedPattern::unserialize(buffer);
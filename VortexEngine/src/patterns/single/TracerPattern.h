@@ -15,15 +15,18 @@ public:
 
   virtual void play() override;
 
+  virtual RGBColor evaluate(uint64_t tick, LedPos pos) const override;
+  virtual uint32_t cycleTicks() const override;
+
   virtual void serialize(SerialBuffer &buffer) const override;
-  virtual void unserialize(SerialBuffer &buffer) override;
+  virtual void unserialize(SerialBufferView &buffer) override;
 
 private:
   // the duration the light is on/off for
   uint8_t m_tracerDuration;
   uint8_t m_dotDuration;
   // the timer for performing blinks
-  Timer m_blinkTimer;
+  InlineTimer<2> m_blinkTimer;
   // the counter for dot color
   uint8_t m_dotColor;
 };